@@ -0,0 +1,82 @@
+/*
+    nanogui/async.h -- Shared worker threads for background work started
+    from widgets, with cooperative cancellation
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Cooperative cancellation flag shared between the UI and a task
+ *
+ * Copies refer to the same flag. Background work is expected to check
+ * \ref cancelled() now and then and return early once it is set.
+ */
+class NANOGUI_EXPORT CancelToken {
+public:
+    CancelToken() : mFlag(std::make_shared<std::atomic<bool>>(false)) { }
+
+    /// Request cancellation (any thread)
+    void cancel() const { mFlag->store(true, std::memory_order_release); }
+
+    /// Return whether cancellation was requested (any thread)
+    bool cancelled() const { return mFlag->load(std::memory_order_acquire); }
+
+    bool operator==(const CancelToken &other) const { return mFlag == other.mFlag; }
+    bool operator!=(const CancelToken &other) const { return mFlag != other.mFlag; }
+
+protected:
+    std::shared_ptr<std::atomic<bool>> mFlag;
+};
+
+/**
+ * \brief Process-wide pool of worker threads for background work
+ *
+ * Used by \ref Widget::runAsync(). The workers are started on the first
+ * call to \ref submit() and stopped when the program exits; tasks which
+ * are still queued at that point are discarded.
+ */
+class NANOGUI_EXPORT WorkerPool {
+public:
+    /// Return the shared pool
+    static WorkerPool &shared();
+
+    ~WorkerPool();
+
+    /// Queue a task for one of the workers (any thread)
+    void submit(std::function<void()> task);
+
+    /// Return the number of worker threads
+    int threadCount() const;
+
+protected:
+    WorkerPool() { }
+
+    void start();
+
+    std::mutex mMutex;
+    std::condition_variable mCond;
+    std::deque<std::function<void()>> mQueue;
+    std::vector<std::thread> mWorkers;
+    bool mStop = false;
+};
+
+NAMESPACE_END(nanogui)
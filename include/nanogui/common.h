@@ -21,6 +21,7 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <functional>
 
 /* Set to 1 to draw boxes around widgets */
 //#define NANOGUI_SHOW_WIDGET_BOUNDS 1
@@ -183,6 +184,19 @@ using std::dynamic_pointer_cast;
 using std::static_pointer_cast;
 
 
+/// Trade-off between responsiveness and power use of \ref mainloop()
+enum class PowerPolicy {
+    Performance, ///< Draw every screen whenever the loop wakes up
+    Balanced,    ///< Draw unfocused, idle screens at a reduced rate (default)
+    Saver        ///< Draw unfocused, idle screens rarely and check bound values less often
+};
+
+/// Set the power policy used by \ref mainloop() (see \ref Screen::setBackgroundFrameRate())
+extern NANOGUI_EXPORT void setPowerPolicy(PowerPolicy policy);
+
+/// Return the power policy used by \ref mainloop()
+extern NANOGUI_EXPORT PowerPolicy powerPolicy();
+
 /// Static initialization; should be called once before invoking any NanoGUI functions
 extern NANOGUI_EXPORT void init();
 
@@ -195,6 +209,30 @@ extern NANOGUI_EXPORT void mainloop();
 /// Request the application main loop to terminate
 extern NANOGUI_EXPORT void leave();
 
+/**
+ * Run \c task on the main thread during the next iteration of \ref mainloop().
+ * Safe to call from any thread; wakes up the main loop if it is waiting.
+ * Tasks run while holding the UI lock of every screen (see
+ * \ref Screen::uiLock()), which also applies to \ref postAfterFrame() and
+ * \ref postDelayed(), so they may modify widgets even when a screen uses
+ * threaded rendering. For the same reason they must not destroy a screen.
+ */
+extern NANOGUI_EXPORT void post(std::function<void()> task);
+
+/**
+ * Run \c task on the main thread once \ref mainloop() has drawn the next
+ * frame. Safe to call from any thread; tasks queued while such tasks run
+ * wait for the frame after.
+ */
+extern NANOGUI_EXPORT void postAfterFrame(std::function<void()> task);
+
+/**
+ * Run \c task on the main thread once \c delay seconds have passed. Safe
+ * to call from any thread; the timers are checked by the refresh thread of
+ * \ref mainloop() and fire with a granularity of about 16 ms.
+ */
+extern NANOGUI_EXPORT void postDelayed(std::function<void()> task, double delay);
+
 #if defined(__APPLE__)
 /**
  * \brief Move to the application bundle's parent directory
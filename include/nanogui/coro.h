@@ -0,0 +1,149 @@
+/*
+    nanogui/coro.h -- Optional C++20 coroutine support for writing UI
+    callbacks that wait for background work, frames or timers
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/async.h>
+
+/* The library itself is built as C++11; this header is only active in
+   translation units compiled with coroutine support */
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Fire-and-forget coroutine started from a UI callback
+ *
+ * A lambda returning \ref Task can be passed wherever a callback is
+ * expected, e.g.
+ *
+ * \code
+ * button->setCallback([label]() -> nanogui::Task {
+ *     std::string text = co_await nanogui::background([]() { return load(); });
+ *     label->setCaption(text);
+ * });
+ * \endcode
+ *
+ * The coroutine runs on the main thread until its first \c co_await, and
+ * \ref mainloop() resumes it on the main thread afterwards. Widgets
+ * captured by the coroutine should be held by \ref ref or checked through
+ * a \ref weakref, as they may be disposed while it is suspended. An
+ * exception leaving the coroutine is caught and logged, and ends the
+ * coroutine without affecting the main loop.
+ */
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() {
+            try {
+                throw;
+            } catch (const std::exception &e) {
+                std::cerr << "Caught exception in coroutine: " << e.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Caught unknown exception in coroutine" << std::endl;
+            }
+        }
+    };
+};
+
+/// Awaitable returned by \ref background()
+template <typename Func> class BackgroundAwaiter {
+public:
+    typedef std::invoke_result_t<Func> Result;
+
+    explicit BackgroundAwaiter(Func func) : mFunc(std::move(func)) { }
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        /* The awaiter lives in the suspended coroutine frame */
+        WorkerPool::shared().submit([this, handle]() {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    mFunc();
+                    mResult.emplace();
+                } else {
+                    mResult.emplace(mFunc());
+                }
+            } catch (...) {
+                mError = std::current_exception();
+            }
+            nanogui::post([handle]() { handle.resume(); });
+        });
+    }
+
+    Result await_resume() {
+        if (mError)
+            std::rethrow_exception(mError);
+        if constexpr (!std::is_void_v<Result>)
+            return std::move(*mResult);
+    }
+
+protected:
+    struct Empty { };
+    typedef std::conditional_t<std::is_void_v<Result>, Empty, Result> Storage;
+
+    Func mFunc;
+    std::optional<Storage> mResult;
+    std::exception_ptr mError;
+};
+
+/// Awaitable returned by \ref nextFrame()
+struct NextFrameAwaiter {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        postAfterFrame([handle]() { handle.resume(); });
+    }
+    void await_resume() { }
+};
+
+/// Awaitable returned by \ref delay()
+struct DelayAwaiter {
+    double seconds;
+
+    bool await_ready() const noexcept { return seconds <= 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        postDelayed([handle]() { handle.resume(); }, seconds);
+    }
+    void await_resume() { }
+};
+
+/**
+ * Run \c func on the shared \ref WorkerPool and resume on the main thread
+ * with its result (or exception) once it has returned
+ */
+template <typename Func> BackgroundAwaiter<std::decay_t<Func>> background(Func &&func) {
+    return BackgroundAwaiter<std::decay_t<Func>>(std::forward<Func>(func));
+}
+
+/// Resume on the main thread after \ref mainloop() has drawn the next frame
+inline NextFrameAwaiter nextFrame() { return NextFrameAwaiter(); }
+
+/// Resume on the main thread after \c milliseconds have passed
+inline DelayAwaiter delay(int milliseconds) { return DelayAwaiter { milliseconds / 1000.0 }; }
+
+NAMESPACE_END(nanogui)
+
+#endif
+#endif
@@ -13,6 +13,7 @@
 
 #include <nanogui/opengl.h>
 #include <map>
+#include <functional>
 
 namespace half_float { class half; }
 
@@ -31,6 +32,106 @@ template <> struct type_traits<double> { enum { type = GL_DOUBLE, integral = 0 }
 template <> struct type_traits<float> { enum { type = GL_FLOAT, integral = 0 }; };
 template <> struct type_traits<half_float::half> { enum { type = GL_HALF_FLOAT, integral = 0 }; };
 
+/**
+ * \brief Pre-resolved location of a shader uniform
+ *
+ * Obtained once via \ref GLShader::uniformHandle(); passing it to the
+ * handle-based \ref GLShader::setUniform() overloads avoids any name lookup
+ * or OpenGL query when setting uniforms in the draw loop
+ */
+struct UniformHandle {
+    GLint location;
+
+    UniformHandle(GLint location = -1) : location(location) { }
+
+    /// Return whether the handle refers to an active uniform
+    bool valid() const { return location >= 0; }
+};
+
+/**
+ * \brief Describes several vertex attributes packed into one interleaved buffer
+ *
+ * Attributes are laid out in the order in which they are added; the stride
+ * and offsets are computed automatically. A nonzero divisor turns all of
+ * them into per-instance attributes for use with the instanced draw calls
+ * of \ref GLShader.
+ */
+class NANOGUI_EXPORT VertexLayout {
+public:
+    struct Attribute {
+        std::string name;
+        GLint dim;
+        GLenum glType;
+        GLboolean normalized;
+        size_t offset;
+    };
+
+    VertexLayout() : mStride(0), mDivisor(0) { }
+
+    /// Append an attribute with \c dim components of type \c T
+    template <typename T> VertexLayout &add(const std::string &name, int dim,
+                                            bool normalized = (bool) type_traits<T>::integral) {
+        Attribute attr;
+        attr.name = name;
+        attr.dim = dim;
+        attr.glType = (GLenum) type_traits<T>::type;
+        attr.normalized = normalized ? GL_TRUE : GL_FALSE;
+        attr.offset = mStride;
+        mAttributes.push_back(attr);
+        mStride += (size_t) dim * sizeof(T);
+        return *this;
+    }
+
+    /// Skip \c bytes of padding (e.g. to keep vertices aligned)
+    VertexLayout &pad(size_t bytes) { mStride += bytes; return *this; }
+
+    /// Return whether two layouts describe the same attributes, stride and divisor
+    bool operator==(const VertexLayout &other) const {
+        if (mStride != other.mStride || mDivisor != other.mDivisor ||
+            mAttributes.size() != other.mAttributes.size())
+            return false;
+        for (size_t i = 0; i < mAttributes.size(); ++i) {
+            const Attribute &a = mAttributes[i], &b = other.mAttributes[i];
+            if (a.name != b.name || a.dim != b.dim || a.glType != b.glType ||
+                a.normalized != b.normalized || a.offset != b.offset)
+                return false;
+        }
+        return true;
+    }
+    bool operator!=(const VertexLayout &other) const { return !operator==(other); }
+
+    /// Return the list of attributes
+    const std::vector<Attribute> &attributes() const { return mAttributes; }
+
+    /// Return the size of one vertex in bytes
+    size_t stride() const { return mStride; }
+
+    /// Return the instancing divisor (0: per-vertex data)
+    uint32_t divisor() const { return mDivisor; }
+    /// Advance the attributes once every \c divisor instances instead of once per vertex
+    VertexLayout &setDivisor(uint32_t divisor) { mDivisor = divisor; return *this; }
+
+protected:
+    std::vector<Attribute> mAttributes;
+    size_t mStride;
+    uint32_t mDivisor;
+};
+
+/**
+ * \brief Strategy used by \ref GLShader when refreshing attribute buffers
+ *
+ * <tt>Static</tt> rewrites the existing storage in place and only reallocates
+ * when the data outgrows it. <tt>Orphan</tt> detaches the old storage first so
+ * that a whole-buffer refresh never waits for pending draws. <tt>Stream</tt>
+ * rotates through a ring of segments guarded by fences, which is the right
+ * choice for data that changes every frame.
+ */
+enum class BufferUpdate {
+    Static = 0,
+    Orphan,
+    Stream
+};
+
 /**
  * Helper class for compiling and linking OpenGL shaders and uploading
  * associated vertex and index buffers from Eigen matrices
@@ -42,7 +143,15 @@ public:
         : mVertexShader(0), mFragmentShader(0), mGeometryShader(0),
           mProgramShader(0), mVertexArrayObject(0) { }
 
-    /// Initialize the shader using the specified source strings
+    /// Abandons any pending asynchronous initialization (GL objects must be released via \ref free())
+    ~GLShader();
+
+    /**
+     * Initialize the shader using the specified source strings. If
+     * \ref shareProgram() is enabled, a program linked by another instance
+     * from identical sources in the same context is reused instead of
+     * compiling it again.
+     */
     bool init(const std::string &name, const std::string &vertex_str,
               const std::string &fragment_str,
               const std::string &geometry_str = "");
@@ -53,9 +162,65 @@ public:
                        const std::string &fragment_fname,
                        const std::string &geometry_fname = "");
 
+    /**
+     * Initialize the shader without blocking on the driver. Compilation and
+     * linking run in parallel when \c KHR_parallel_shader_compile is
+     * available, and are otherwise spread over subsequent frames one stage
+     * at a time. Progress is made by \ref ready() and by
+     * \ref processPending(), which \ref Screen calls once per frame. Draw
+     * calls are ignored until the shader is ready, and attributes should be
+     * uploaded from \c callback, which receives whether initialization
+     * succeeded. Returns \c true if the program was available immediately
+     * (in which case \c callback has already been invoked).
+     */
+    bool initAsync(const std::string &name, const std::string &vertex_str,
+                   const std::string &fragment_str,
+                   const std::string &geometry_str = "",
+                   const std::function<void(bool)> &callback = std::function<void(bool)>());
+
+    /// Asynchronous counterpart of \ref initFromFiles()
+    bool initAsyncFromFiles(const std::string &name,
+                            const std::string &vertex_fname,
+                            const std::string &fragment_fname,
+                            const std::string &geometry_fname = "",
+                            const std::function<void(bool)> &callback = std::function<void(bool)>());
+
+    /// Advance a pending asynchronous initialization and return whether the program is usable
+    bool ready();
+
+    /// Advance all pending asynchronous initializations in the current context
+    static void processPending();
+
     /// Return the name of the shader
     const std::string &name() const { return mName; }
 
+    /**
+     * Allow \ref init() and \ref initAsync() to reuse the GL program of other
+     * sharing instances with identical sources (disabled by default). Shared
+     * instances also share their uniform values, so this is only suitable
+     * for shaders whose uniforms are set before every draw call.
+     */
+    void setShareProgram(bool share) { mShareProgram = share; }
+    /// Return whether the GL program may be shared with other instances
+    bool shareProgram() const { return mShareProgram; }
+
+    /// Forget the programs and driver capabilities cached for a context that is being destroyed
+    static void release(GLFWwindow *context);
+
+    /// State of an initialization started by \ref initAsync() (opaque)
+    struct AsyncInit;
+
+    /**
+     * Set a directory in which linked program binaries are persisted across
+     * runs (empty to disable, the default). Entries are keyed on the shader
+     * sources, definitions and driver, and are silently recompiled when the
+     * driver rejects them. Requires GL 4.1 or ARB_get_program_binary.
+     */
+    static void setCacheDirectory(const std::string &path);
+
+    /// Return the program binary cache directory
+    static const std::string &cacheDirectory();
+
     /// Set a preprocessor definition
     void define(const std::string &key, const std::string &value) { mDefinitions[key] = value; }
 
@@ -71,6 +236,11 @@ public:
     /// Return the handle of a uniform attribute (-1 if it does not exist)
     GLint uniform(const std::string &name, bool warn = true) const;
 
+    /// Resolve a uniform once so that it can be set without any lookups later on
+    UniformHandle uniformHandle(const std::string &name, bool warn = true) const {
+        return UniformHandle(uniform(name, warn));
+    }
+
     /// Upload an Eigen matrix as a vertex buffer object (refreshing it as needed)
     template <typename Matrix> void uploadAttrib(const std::string &name, const Matrix &M, int version = -1) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
@@ -81,26 +251,76 @@ public:
                      glType, integral, (const uint8_t *) M.data(), version);
     }
 
+    /**
+     * \brief Overwrite part of a previously uploaded vertex buffer object
+     *
+     * \c offset is given in columns (i.e. vertices) of the original upload;
+     * the buffer is neither resized nor reallocated.
+     */
+    template <typename Matrix> void updateAttrib(const std::string &name, uint32_t offset, const Matrix &M) {
+        uint32_t compSize = sizeof(typename Matrix::Scalar);
+
+        updateAttrib(name, offset, (uint32_t) M.size(), (int) M.rows(), compSize,
+                     (const uint8_t *) M.data());
+    }
+
     /// Download a vertex buffer object into an Eigen matrix
     template <typename Matrix> void downloadAttrib(const std::string &name, Matrix &M) {
         uint32_t compSize = sizeof(typename Matrix::Scalar);
         GLuint glType = (GLuint) type_traits<typename Matrix::Scalar>::type;
 
-        auto it = mBufferObjects.find(name);
-        if (it == mBufferObjects.end())
+        const Buffer *buf = findBuffer(name);
+        if (!buf)
             throw std::runtime_error("downloadAttrib(" + mName + ", " + name + ") : buffer not found!");
 
-        const Buffer &buf = it->second;
-        M.resize(buf.dim, buf.size / buf.dim);
+        M.resize(buf->dim, buf->size / buf->dim);
 
         downloadAttrib(name, M.size(), M.rows(), compSize, glType, (uint8_t *) M.data());
     }
 
+    /**
+     * \brief Download a buffer object without stalling the pipeline
+     *
+     * The contents are copied into a pixel pack buffer on the GPU and
+     * \c callback receives the raw bytes once the copy has completed,
+     * typically one or two frames later (see \ref GLReadback).
+     */
+    void downloadAttribAsync(const std::string &name,
+                             const std::function<void(const uint8_t *data, size_t size)> &callback);
+
     /// Upload an index buffer
     template <typename Matrix> void uploadIndices(const Matrix &M) {
         uploadAttrib("indices", M);
     }
 
+    /**
+     * \brief Upload \c count interleaved vertices into a single buffer object
+     *
+     * \c data must point to \c count records laid out as described by
+     * \c layout. The buffer is registered under \c name, while the shader
+     * attributes are looked up via the names stored in the layout.
+     */
+    void uploadInterleaved(const std::string &name, const VertexLayout &layout,
+                           const void *data, uint32_t count, int version = -1);
+
+    /// Upload a vector of interleaved vertex records (see above)
+    template <typename Vertex> void uploadInterleaved(const std::string &name, const VertexLayout &layout,
+                                                      const std::vector<Vertex> &data, int version = -1) {
+        uploadInterleaved(name, layout, data.data(), (uint32_t) data.size(), version);
+    }
+
+    /// Turn a separately uploaded attribute into a per-instance attribute (0: per-vertex)
+    void setAttribDivisor(const std::string &name, uint32_t divisor);
+
+    /// Select how subsequent uploads refresh the given attribute buffer (default: \ref BufferUpdate::Static)
+    void setAttribUpdateMode(const std::string &name, BufferUpdate mode);
+
+    /// Return how uploads refresh the given attribute buffer
+    BufferUpdate attribUpdateMode(const std::string &name) const {
+        const Buffer *buf = findBuffer(name);
+        return buf ? buf->mode : BufferUpdate::Static;
+    }
+
     /// Invalidate the version numbers assiciated with attribute data
     void invalidateAttribs();
 
@@ -108,11 +328,8 @@ public:
     void freeAttrib(const std::string &name);
 
     /// Check if an attribute was registered a given name
-    bool hasAttrib(const std::string &name) const { 
-        auto it = mBufferObjects.find(name);
-        if (it == mBufferObjects.end())
-            return false;
-        return true;
+    bool hasAttrib(const std::string &name) const {
+        return findBuffer(name) != nullptr;
     }
 
     /// Create a symbolic link to an attribute of another GLShader. This avoids duplicating unnecessary data
@@ -120,17 +337,15 @@ public:
 
     /// Return the version number of a given attribute
     int attribVersion(const std::string &name) const {
-        auto it = mBufferObjects.find(name);
-        if (it == mBufferObjects.end())
-            return -1;
-        return it->second.version;
+        const Buffer *buf = findBuffer(name);
+        return buf ? buf->version : -1;
     }
 
     /// Reset the version number of a given attribute
     void resetAttribVersion(const std::string &name) {
-        auto it = mBufferObjects.find(name);
-        if (it != mBufferObjects.end())
-            it->second.version = -1;
+        Buffer *buf = findBuffer(name);
+        if (buf)
+            buf->version = -1;
     }
 
     /// Draw a sequence of primitives
@@ -139,6 +354,12 @@ public:
     /// Draw a sequence of primitives using a previously uploaded index buffer
     void drawIndexed(int type, uint32_t offset, uint32_t count);
 
+    /// Draw \c instanceCount copies of a sequence of primitives
+    void drawArrayInstanced(int type, uint32_t offset, uint32_t count, uint32_t instanceCount);
+
+    /// Draw \c instanceCount copies of a sequence of indexed primitives
+    void drawIndexedInstanced(int type, uint32_t offset, uint32_t count, uint32_t instanceCount);
+
     /// Initialize a uniform parameter with a 4x4 matrix
     void setUniform(const std::string &name, const Matrix4f &mat, bool warn = true) {
         glUniformMatrix4fv(uniform(name, warn), 1, GL_FALSE, glm::value_ptr(mat));
@@ -169,45 +390,167 @@ public:
         glUniform4f(uniform(name, warn), v.x, v.y, v.z, v.w);
     }
 
+    /// Initialize a pre-resolved uniform parameter with a 4x4 matrix
+    void setUniform(UniformHandle h, const Matrix4f &mat) {
+        glUniformMatrix4fv(h.location, 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    /// Initialize a pre-resolved uniform parameter with an integer value
+    void setUniform(UniformHandle h, int value) {
+        glUniform1i(h.location, value);
+    }
+
+    /// Initialize a pre-resolved uniform parameter with a float value
+    void setUniform(UniformHandle h, float value) {
+        glUniform1f(h.location, value);
+    }
+
+    /// Initialize a pre-resolved uniform parameter with a 2D vector
+    void setUniform(UniformHandle h, const Vector2f &v) {
+        glUniform2f(h.location, v.x, v.y);
+    }
+
+    /// Initialize a pre-resolved uniform parameter with a 3D vector
+    void setUniform(UniformHandle h, const Vector3f &v) {
+        glUniform3f(h.location, v.x, v.y, v.z);
+    }
+
+    /// Initialize a pre-resolved uniform parameter with a 4D vector
+    void setUniform(UniformHandle h, const Vector4f &v) {
+        glUniform4f(h.location, v.x, v.y, v.z, v.w);
+    }
+
     /// Return the size of all registered buffers in bytes
     size_t bufferSize() const {
         size_t size = 0;
         for (auto const &buf : mBufferObjects)
-            size += buf.second.size;
+            size += buf.size;
         return size;
     }
 protected:
     void uploadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, bool integral, 
                        const uint8_t *data, int version = -1);
+    void updateAttrib(const std::string &name, uint32_t offset, uint32_t size,
+                      int dim, uint32_t compSize, const uint8_t *data);
     void downloadAttrib(const std::string &name, uint32_t size, int dim,
                        uint32_t compSize, GLuint glType, uint8_t *data);
 protected:
+    /// Number of ring segments used by \ref BufferUpdate::Stream buffers
+    enum { StreamSegments = 3 };
+
     struct Buffer {
+        std::string name;
+        GLint attribID;
         GLuint id;
         GLuint glType;
         GLuint dim;
         GLuint compSize;
         GLuint size;
         int version;
+        BufferUpdate mode;
+        size_t capacity;     /* Bytes allocated (per segment when streaming) */
+        size_t offset;       /* Byte offset of the live data */
+        int segment;         /* Current ring segment when streaming */
+        GLsync fences[StreamSegments];
+        bool integral;
+        GLuint divisor;
+        VertexLayout layout; /* Non-empty for interleaved buffers */
+    };
+
+    /// Entry of the reflected uniform/attribute tables (sorted by name)
+    struct Variable {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
     };
+
+    /// Query the active uniforms and attributes of the linked program once
+    void reflect();
+
+    static const Variable *findVariable(const std::vector<Variable> &table, const std::string &name);
+    Buffer *findBuffer(const std::string &name);
+    const Buffer *findBuffer(const std::string &name) const;
+    /// Add a buffer object in its initial state (\c attribID is -1 for interleaved buffers)
+    Buffer *createBuffer(const std::string &name, GLint attribID);
+    static void releaseBuffer(Buffer &buffer);
+    void writeBuffer(Buffer &buf, GLenum target, const uint8_t *data, size_t totalSize);
+    void bindAttribPointers(const Buffer &buf);
+
+    /// Common setup of \ref init() and \ref initAsync(), returns the definitions preamble
+    std::string prepare(const std::string &name);
+    /// Reuse a program linked by another instance or stored in the binary cache
+    bool acquireProgram(uint64_t key);
+    /// Make the linked program available to other sharing instances
+    void registerProgram(uint64_t key);
+    /// Create the program from the compiled stages and submit it for linking
+    void linkProgram();
+    /// Check the link status, then cache and reflect the program
+    void finishProgram(uint64_t key);
+
+    bool advanceAsync();
+    void cancelAsync();
+
     std::string mName;
     GLuint mVertexShader;
     GLuint mFragmentShader;
     GLuint mGeometryShader;
     GLuint mProgramShader;
     GLuint mVertexArrayObject;
-    std::map<std::string, Buffer> mBufferObjects;
+    uint64_t mProgramKey = 0; /* Non-zero when the program is shared via the cache */
+    bool mShareProgram = false;
+    std::shared_ptr<AsyncInit> mAsync; /* Non-null while initAsync() is in flight */
+    std::vector<Buffer> mBufferObjects;
+    size_t mIndexOffset = 0;
+    std::vector<Variable> mUniforms;
+    std::vector<Variable> mAttribs;
     std::map<std::string, std::string> mDefinitions;
 };
 
+/**
+ * \brief Non-blocking transfers of GPU data back to the CPU
+ *
+ * Reads are issued into pixel pack buffers followed by a fence. Completed
+ * transfers are mapped and handed to their callbacks by \ref process(),
+ * which \ref Screen calls once per frame in its own context, so data
+ * usually arrives one or two frames after the request.
+ */
+class NANOGUI_EXPORT GLReadback {
+public:
+    typedef std::function<void(const uint8_t *data, size_t size)> Callback;
+
+    /**
+     * Read an RGBA8 region of the currently bound read framebuffer. Rows
+     * are delivered bottom-up, following the OpenGL convention.
+     */
+    static void readPixels(const Vector2i &offset, const Vector2i &size,
+                           const Callback &callback);
+
+    /// Copy \c size bytes starting at \c offset from a buffer object
+    static void readBuffer(GLuint buffer, size_t offset, size_t size,
+                           const Callback &callback);
+
+    /**
+     * Deliver completed transfers of the current context. With \c wait set,
+     * blocks until all of them have completed. Returns the number of
+     * transfers that are still in flight.
+     */
+    static size_t process(bool wait = false);
+
+    /// Drop pending transfers and pooled buffers of the current context
+    static void clear();
+};
+
 /// Helper class for creating framebuffer objects
 class NANOGUI_EXPORT GLFramebuffer {
+    friend class GLFramebufferPool;
 public:
-    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mSamples(0) { }
+    GLFramebuffer() : mFramebuffer(0), mDepth(0), mColor(0), mSamples(0),
+                      mColorFormat(GL_RGBA8), mResolveFramebuffer(0), mResolveColor(0) { }
 
-    /// Create a new framebuffer with the specified size and number of MSAA samples
-    void init(const Vector2i &size, int nSamples);
+    /// Create a new framebuffer with the specified size, number of MSAA samples and color format
+    void init(const Vector2i &size, int nSamples, GLenum colorFormat = GL_RGBA8);
 
     /// Release all associated resources
     void free();
@@ -226,10 +569,78 @@ public:
 
     /// Return the number of MSAA samples
     int samples() const { return mSamples; }
+
+    /// Return the size of the framebuffer
+    const Vector2i &size() const { return mSize; }
+
+    /**
+     * Return the size of the underlying storage, which may exceed \ref size()
+     * for framebuffers handed out by a \ref GLFramebufferPool
+     */
+    const Vector2i &allocatedSize() const { return mAllocatedSize; }
+
+    /// Return the internal format of the color attachment
+    GLenum colorFormat() const { return mColorFormat; }
+
+    /**
+     * Asynchronously read back the color attachment as bottom-up RGBA8 rows.
+     * Multisampled framebuffers are resolved first.
+     */
+    void readPixelsAsync(const std::function<void(const Vector2i &size, const uint8_t *rgba)> &callback);
 protected:
     GLuint mFramebuffer, mDepth, mColor;
-    Vector2i mSize;
+    Vector2i mSize, mAllocatedSize;
     int mSamples;
+    GLenum mColorFormat;
+    /* Single-sampled target used to resolve MSAA contents for readback */
+    GLuint mResolveFramebuffer, mResolveColor;
+};
+
+/**
+ * \brief Recycles framebuffers keyed by (size bucket, format, samples)
+ *
+ * Requested sizes are rounded up to a multiple of the bucket granularity, so
+ * that live-resizing a view only reallocates when a bucket boundary is
+ * crossed. The returned framebuffer reports the requested \ref
+ * GLFramebuffer::size() (use it for the viewport), while its storage spans
+ * the whole bucket. Released framebuffers are kept for a few frames before
+ * they are actually deleted by \ref collect().
+ */
+class NANOGUI_EXPORT GLFramebufferPool {
+public:
+    GLFramebufferPool(int granularity = 64, int retainFrames = 3)
+        : mGranularity(granularity), mRetainFrames(retainFrames), mFrame(0) { }
+
+    ~GLFramebufferPool() { clear(); }
+
+    /// Return a framebuffer of at least the given size, reusing a released one when possible
+    ref<GLFramebuffer> acquire(const Vector2i &size, int nSamples = 1,
+                               GLenum colorFormat = GL_RGBA8);
+
+    /// Return a framebuffer to the pool
+    void release(const ref<GLFramebuffer> &framebuffer);
+
+    /// Advance the frame counter and delete framebuffers that went unused for too long
+    void collect();
+
+    /// Delete all pooled framebuffers (requires the owning context to be current)
+    void clear();
+
+    /// Return the number of framebuffers waiting to be reused
+    size_t available() const { return mFree.size(); }
+
+protected:
+    struct Entry {
+        ref<GLFramebuffer> framebuffer;
+        uint64_t releasedFrame;
+    };
+
+    Vector2i bucket(const Vector2i &size) const;
+
+    int mGranularity;
+    int mRetainFrames;
+    uint64_t mFrame;
+    std::vector<Entry> mFree;
 };
 
 NAMESPACE_END(nanogui)
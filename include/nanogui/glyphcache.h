@@ -0,0 +1,116 @@
+/*
+    nanogui/glyphcache.h -- Pre-rasterizes declared glyph sets into the
+    NanoVG font atlas so that the first frames do not stutter
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+#include <deque>
+#include <set>
+#include <string>
+#include <tuple>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Warms up the NanoVG font atlas ahead of time
+ *
+ * Applications declare which (font, size, codepoint range) combinations
+ * they are going to display. The glyphs are then rasterized a few at a
+ * time at the start of each frame by \ref Screen (within a time budget)
+ * instead of in the middle of the first frame that shows them.
+ *
+ * The declarations can be saved to a manifest file and loaded again on the
+ * next start, so that the same glyph set is warmed before the first paint.
+ * Fontstash keeps its atlas private to NanoVG, hence rasterization has to
+ * happen on the thread owning the GL context and the atlas pixels cannot
+ * be persisted themselves; the statistics are likewise estimated from the
+ * glyphs warmed through this class.
+ */
+class NANOGUI_EXPORT GlyphCache {
+public:
+    /// Inclusive range of Unicode codepoints
+    struct Range {
+        uint32_t first, last;
+    };
+
+    /// Estimated font atlas usage
+    struct Stats {
+        size_t glyphsWarmed = 0;    ///< Glyphs rasterized through the cache
+        size_t glyphsPending = 0;   ///< Declared glyphs still waiting to be rasterized
+        size_t area = 0;            ///< Approximate atlas area taken by warmed glyphs (pixels)
+        Vector2i atlasSize;         ///< Atlas size NanoVG needs for that area
+        int atlasResizes = 0;       ///< Times NanoVG had to grow its atlas to get there
+        float occupancy = 0.f;      ///< Fraction of the atlas taken by warmed glyphs
+    };
+
+    /// Return the glyph cache of a NanoVG context, creating it if needed
+    static GlyphCache &get(NVGcontext *ctx);
+
+    /// Return the glyph cache of a NanoVG context if one was created
+    static GlyphCache *find(NVGcontext *ctx);
+
+    /// Destroy the glyph cache of a NanoVG context
+    static void release(NVGcontext *ctx);
+
+    /// Printable ASCII characters
+    static Range basicLatin() { return Range { 0x20, 0x7E }; }
+
+    /// Latin-1 supplement (accented characters)
+    static Range latin1() { return Range { 0xA0, 0xFF }; }
+
+    /// Declare that the given codepoints will be drawn with a font face at a size
+    void declare(const std::string &font, float size, const std::vector<Range> &ranges);
+
+    /// Return whether declared glyphs are waiting to be rasterized
+    bool pending() const { return !mQueue.empty(); }
+
+    /**
+     * Rasterize pending glyphs for at most \c budget seconds (all of them if
+     * the budget is negative). Must be called between \c nvgBeginFrame() and
+     * \c nvgEndFrame(), as NanoVG only rasterizes glyphs when drawing text.
+     */
+    void prewarm(float pixelRatio, double budget);
+
+    /// Declare all (font, size, range) entries from a manifest written by \ref saveManifest()
+    bool loadManifest(const std::string &path);
+
+    /// Write all declarations to a manifest file
+    bool saveManifest(const std::string &path) const;
+
+    /// Return estimated atlas statistics
+    Stats stats() const;
+
+protected:
+    GlyphCache(NVGcontext *ctx) : mContext(ctx) { }
+
+    struct Declaration {
+        std::string font;
+        float size;
+        Range range;
+    };
+
+    struct Glyph {
+        std::string font;
+        float size;
+        uint32_t codepoint;
+    };
+
+    NVGcontext *mContext;
+    std::vector<Declaration> mDeclarations;
+    std::deque<Glyph> mQueue;
+    std::set<std::tuple<std::string, float, uint32_t>> mKnown;
+    size_t mWarmed = 0;
+    double mArea = 0;
+};
+
+NAMESPACE_END(nanogui)
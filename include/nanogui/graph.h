@@ -12,6 +12,8 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/telemetry.h>
+#include <memory>
 #include <vector>
 
 NAMESPACE_BEGIN(nanogui)
@@ -42,12 +44,26 @@ public:
     std::vector<float> &values() { return mValues; }
     void setValues(const std::vector<float> &values) { mValues = values; }
 
+    /**
+     * Append the values pushed to \c source every time the graph is drawn,
+     * keeping the most recent \c history ones (0: the capacity of the
+     * ring buffer). The graph is the consumer of the ring buffer, which must
+     * outlive the binding; a frame is requested when new values arrive.
+     */
+    void bind(RingBuffer<float> &source, size_t history = 0);
+
+    /// Stop consuming the bound ring buffer
+    void unbind();
+
     virtual Vector2i preferredSize(NVGcontext *ctx) const;
     virtual void draw(NVGcontext *ctx);
 protected:
     std::string mCaption, mHeader, mFooter;
     Color mBackgroundColor, mForegroundColor, mTextColor;
     std::vector<float> mValues;
+    RingBuffer<float> *mSource = nullptr;
+    size_t mHistory = 0;
+    std::unique_ptr<TelemetryWatch> mWatch;
 };
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,165 @@
+/*
+    nanogui/imageatlas.h -- Packs small images (icons, unit images,
+    thumbnails) into shared NanoVG textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+#include <map>
+#include <string>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Shelf-packed texture atlas for small images
+ *
+ * Every image added to the atlas is identified by a negative ID (<= -2),
+ * which can be used wherever NanoGUI expects an image icon, so that many
+ * icons share a handful of textures and NanoVG can keep batching. Use
+ * \ref nvgImageIconSize() and \ref nvgImageIconPattern() to draw IDs that
+ * may either refer to the atlas or to a standalone NanoVG image.
+ *
+ * Removing images leaves holes behind; once a page becomes too fragmented,
+ * its live images are migrated to other pages a few at a time from
+ * \ref update(), which \ref Screen calls once per frame.
+ *
+ * NanoVG contexts whose GL contexts share objects can also share an atlas
+ * (see \ref share()); the pages are then wrapped as images of the other
+ * contexts instead of being decoded and uploaded again.
+ */
+class NANOGUI_EXPORT ImageAtlas {
+public:
+    /// Width and height of an atlas page in pixels
+    enum { PageSize = 1024 };
+
+    /// Images with a side longer than this are not accepted
+    enum { MaxImageSize = 256 };
+
+    /// Return the atlas of a NanoVG context, creating it if needed
+    static ImageAtlas &get(NVGcontext *ctx);
+
+    /// Return the atlas of a NanoVG context if one was created
+    static ImageAtlas *find(NVGcontext *ctx);
+
+    /// Destroy the atlas of a NanoVG context (before the context is deleted)
+    static void release(NVGcontext *ctx);
+
+    /**
+     * Let \c ctx use the atlas of \c owner. Both NanoVG contexts must use
+     * GL3 and GL contexts that share objects, and \c owner must be
+     * released last. Textures are only uploaded and repacked through the
+     * owner.
+     */
+    static void share(NVGcontext *ctx, NVGcontext *owner);
+
+    /// Return the context owning the atlas used by \c ctx (\c ctx itself unless shared)
+    static NVGcontext *owner(NVGcontext *ctx);
+
+    /// Return whether \c id refers to an atlas entry
+    static bool isAtlasImage(int id) { return id <= -2; }
+
+    ~ImageAtlas();
+
+    /**
+     * Decode an encoded image (PNG, JPEG, ..) and add it under \c name.
+     * Images already present under that name are returned as is. Returns
+     * 0 if the image could not be decoded or is too large for the atlas.
+     */
+    int add(const std::string &name, const uint8_t *data, uint32_t size);
+
+    /// Return the ID of the image added under \c name, or 0 if there is none
+    int lookup(const std::string &name) const;
+
+    /// Add an image from 8 bit RGBA pixels, see \ref add()
+    int addRGBA(const std::string &name, int width, int height, const uint8_t *rgba);
+
+    /// Remove an image and free its space (reclaimed when the page is repacked)
+    void remove(int id);
+
+    /// Return the size of an atlas image
+    Vector2i imageSize(int id) const;
+
+    /// Create a paint which maps the atlas image \c id onto the rectangle (x, y, w, h)
+    NVGpaint pattern(int id, float x, float y, float w, float h, float alpha) {
+        return pattern(mContext, id, x, y, w, h, alpha);
+    }
+
+    /// Create a paint for drawing with \c ctx, which is the owner or shares the atlas
+    NVGpaint pattern(NVGcontext *ctx, int id, float x, float y, float w, float h, float alpha);
+
+    /// Return the NanoVG context owning the atlas textures
+    NVGcontext *context() const { return mContext; }
+
+    /// Upload modified pages and advance incremental repacking
+    void update();
+
+    /// Return the fraction of allocated atlas area that was freed but not yet reclaimed
+    float fragmentation() const;
+
+    /// Return the number of atlas pages
+    int pageCount() const;
+
+protected:
+    ImageAtlas(NVGcontext *ctx) : mContext(ctx), mNextID(-2) { }
+
+    struct Entry {
+        std::string name;
+        int page;
+        Vector2i pos;   /* Top-left corner of the image (inside its 1px border) */
+        Vector2i size;
+    };
+
+    struct Shelf {
+        int y, height, x;
+    };
+
+    struct Page {
+        int image = 0;
+        std::vector<uint8_t> pixels;
+        std::vector<Shelf> shelves;
+        int top = 0;                /* First row not covered by a shelf */
+        size_t usedArea = 0, freedArea = 0;
+        int entries = 0;
+        bool dirty = false;
+        bool retiring = false;      /* Being emptied by the incremental repacker */
+    };
+
+    bool allocate(const Vector2i &size, int &page, Vector2i &pos, int excludePage);
+    void blit(Entry &entry, const uint8_t *rgba, int stride);
+    int newPage();
+    int pageImage(NVGcontext *ctx, int page);
+    void releaseShared(NVGcontext *ctx);
+
+    NVGcontext *mContext;
+    int mNextID;
+    std::map<int, Entry> mEntries;
+    std::map<std::string, int> mNames;
+    std::vector<Page> mPages;
+    /* (sharing context, page) -> (wrapper image in that context, page image it wraps) */
+    std::map<std::pair<NVGcontext *, int>, std::pair<int, int>> mShared;
+};
+
+/// Return the size of an image icon, which may live in an \ref ImageAtlas or a standalone NanoVG image
+extern NANOGUI_EXPORT void nvgImageIconSize(NVGcontext *ctx, int image, int *w, int *h);
+
+/**
+ * Return an image of \c ctx which refers to the texture of \c image in
+ * \c source, without copying it. Both NanoVG contexts must use GL3 and GL
+ * contexts that share objects; the texture remains owned by \c source.
+ */
+extern NANOGUI_EXPORT int nvgShareImage(NVGcontext *ctx, NVGcontext *source, int image);
+
+/// Create a paint which maps an image icon (atlas entry or NanoVG image) onto the rectangle (x, y, w, h)
+extern NANOGUI_EXPORT NVGpaint nvgImageIconPattern(NVGcontext *ctx, int image, float x, float y,
+                                                   float w, float h, float alpha);
+
+NAMESPACE_END(nanogui)
@@ -12,6 +12,10 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/textlayout.h>
+#include <nanogui/telemetry.h>
+#include <functional>
+#include <memory>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -41,6 +45,39 @@ public:
     /// Set the label color
     void setColor(const Color& color) { mColor = color; }
 
+    /**
+     * Display an externally owned value as text. The source is sampled
+     * every time the label is drawn and the caption is set to
+     * <tt>format(value)</tt> whenever the value changed. The source may be
+     * written from any thread and must outlive the binding; a frame is
+     * requested when it differs from the value drawn last. The label is not
+     * laid out again, so a fixed width is recommended.
+     */
+    template <typename T, typename Format>
+    void bind(const std::atomic<T> &source, const Format &formatter) {
+        unbind();
+        std::function<std::string(T)> format = formatter;
+        const std::atomic<T> *src = &source;
+        auto drawn = std::make_shared<std::atomic<T>>(src->load(std::memory_order_relaxed));
+        mCaption = format(drawn->load(std::memory_order_relaxed));
+        mSample = [this, src, drawn, format]() {
+            T value = src->load(std::memory_order_relaxed);
+            if (value != drawn->load(std::memory_order_relaxed)) {
+                drawn->store(value, std::memory_order_relaxed);
+                mCaption = format(value);
+            }
+        };
+        mWatch.reset(new TelemetryWatch([src, drawn]() {
+            return src->load(std::memory_order_relaxed) != drawn->load(std::memory_order_relaxed);
+        }));
+    }
+
+    /// Stop sampling the bound source (the last caption remains)
+    void unbind() {
+        mWatch.reset();
+        mSample = nullptr;
+    }
+
     /// Compute the size needed to fully display the label
     virtual Vector2i preferredSize(NVGcontext *ctx);
     /// Draw the label
@@ -49,6 +86,9 @@ protected:
     std::string mCaption;
     std::string mFont;
     Color mColor;
+    TextLayout mLayout;
+    std::function<void()> mSample;
+    std::unique_ptr<TelemetryWatch> mWatch;
 };
 
 NAMESPACE_END(nanogui)
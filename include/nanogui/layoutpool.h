@@ -0,0 +1,118 @@
+/*
+    nanogui/layoutpool.h -- Worker threads with private text measurement
+    contexts for laying out independent windows in parallel
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Thread pool for parallel layout
+ *
+ * NanoVG's font stash is not thread safe, hence every worker owns a private
+ * NanoVG context that is only used for measuring text. These contexts have
+ * no GL renderer; they load the same fonts as the main context (registered
+ * with \ref addFont()) and forward image size queries to it, so that
+ * \c preferredSize() and \c performLayout() give the same results on any
+ * thread. The calling thread of \ref run() uses such a context as well, so
+ * the main context is idle while layout runs.
+ *
+ * The workers are started on the first call to \ref run(). Used by
+ * \ref Screen::performLayout() when parallel layout is enabled.
+ */
+class NANOGUI_EXPORT LayoutPool {
+public:
+    /// Return the layout pool of a NanoVG context, creating it if needed
+    static LayoutPool &get(NVGcontext *ctx);
+
+    /// Return the layout pool of a NanoVG context if one was created
+    static LayoutPool *find(NVGcontext *ctx);
+
+    /// Stop the workers of a NanoVG context and destroy their contexts
+    static void release(NVGcontext *ctx);
+
+    /**
+     * Return the main context that a measurement context was created for,
+     * or \c ctx itself if it is not a measurement context. Per-context
+     * caches such as the \ref ImageAtlas are looked up through this.
+     */
+    static NVGcontext *mainContext(NVGcontext *ctx);
+
+    ~LayoutPool();
+
+    /**
+     * Register a font for the measurement contexts under the same name as
+     * used with NanoVG. The font data is not copied and must remain valid.
+     * Every face used by widgets must be registered, otherwise text set in
+     * it measures as empty during parallel layout; \ref Screen::createFont()
+     * takes care of this.
+     */
+    void addFont(const std::string &name, const uint8_t *data, size_t size);
+
+    /// Register a font file for the measurement contexts (see \ref addFont())
+    void addFontFile(const std::string &name, const std::string &filename);
+
+    /// Set the number of worker threads (0: one less than the number of cores)
+    void setThreadCount(int count);
+
+    /// Return the number of worker threads
+    int threadCount() const;
+
+    /**
+     * Call \c func(index, ctx) for every index in [0, count) and wait until
+     * all calls have returned. The calls run concurrently on the workers and
+     * on the calling thread, each with a context that may only be used for
+     * measurement. The first exception thrown by \c func is rethrown here.
+     */
+    void run(size_t count, const std::function<void(size_t, NVGcontext *)> &func);
+
+protected:
+    LayoutPool(NVGcontext *ctx);
+
+    struct Worker;
+    struct Font {
+        std::string name;
+        const uint8_t *data;
+        size_t size;
+        std::string filename; /* Loaded from disk if not empty */
+    };
+
+    Worker *createWorker();
+    void start();
+    void stop();
+    void work(NVGcontext *ctx);
+
+    NVGcontext *mContext;
+    std::vector<Font> mFonts;
+    std::vector<Worker *> mWorkers;
+    Worker *mCaller = nullptr; /* Measurement context of the thread calling run() */
+    int mThreadCount = 0;
+
+    std::mutex mMutex;
+    std::condition_variable mJobCond, mDoneCond;
+    const std::function<void(size_t, NVGcontext *)> *mJob = nullptr;
+    size_t mJobSize = 0, mNext = 0;
+    int mGeneration = 0, mBusy = 0;
+    bool mStop = false;
+    std::exception_ptr mError;
+};
+
+NAMESPACE_END(nanogui)
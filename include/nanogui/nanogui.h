@@ -31,6 +31,16 @@
 #include <nanogui/slider.h>
 #include <nanogui/imagepanel.h>
 #include <nanogui/imageview.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/primitivebatch.h>
+#include <nanogui/shadowcache.h>
+#include <nanogui/glyphcache.h>
+#include <nanogui/textlayout.h>
+#include <nanogui/sdftext.h>
+#include <nanogui/taskqueue.h>
+#include <nanogui/async.h>
+#include <nanogui/telemetry.h>
+#include <nanogui/layoutpool.h>
 #include <nanogui/vscrollpanel.h>
 #include <nanogui/graph.h>
 #include <nanogui/divider.h>
@@ -48,6 +48,9 @@ public:
     /// Draw the popup window
     virtual void draw(NVGcontext* ctx);
 
+    /// Popups follow their parent window and are never used to hide other windows
+    virtual bool opaqueRegion(Vector2i &, Vector2i &) const override { return false; }
+
 	virtual void dispose() override;
 
 	virtual void associate() override;
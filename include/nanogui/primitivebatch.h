@@ -0,0 +1,164 @@
+/*
+    nanogui/primitivebatch.h -- Instanced signed-distance-field renderer
+    for the rounded rectangles that make up most widget chrome
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Draws rounded rectangles as instanced quads with an SDF shader
+ *
+ * Fills, strokes and shadows (a rectangle with a rounded hole) are
+ * evaluated analytically in the fragment shader, using the same gradient
+ * model as NanoVG paints (linear, box and radial gradients), so widgets can
+ * pass the paints they already build. Nothing is tessellated and thousands
+ * of shapes are submitted with a single draw call.
+ *
+ * Batched shapes are drawn underneath the NanoVG content of the same
+ * top-level window, so widgets only batch chrome that no earlier NanoVG
+ * content of their window overlaps (e.g. backgrounds drawn before their
+ * own text, but not a scroll bar drawn over its children). \ref Screen
+ * flushes the batch and NanoVG before a window that overlaps one drawn
+ * since the last flush, which keeps windows stacked correctly while
+ * side-by-side windows share a single draw call. Batching is
+ * enabled per screen via \ref Screen::setBatchedPrimitives(). Widgets use
+ * the \c nvgBatch* functions below, which fall back to NanoVG paths
+ * whenever batching is unavailable.
+ */
+class NANOGUI_EXPORT PrimitiveBatch {
+public:
+    /// Return the batch of a NanoVG context, creating it if needed
+    static PrimitiveBatch &get(NVGcontext *ctx);
+
+    /// Return the batch of a NanoVG context if it is currently accepting shapes
+    static PrimitiveBatch *active(NVGcontext *ctx);
+
+    /// Destroy the batch of a NanoVG context (requires its GL context to be current)
+    static void release(NVGcontext *ctx);
+
+    ~PrimitiveBatch();
+
+    /**
+     * Start accepting shapes for a frame with the given logical size.
+     * Returns \c false while the shader is still being compiled, in which
+     * case the caller should render through NanoVG only.
+     */
+    bool begin(const Vector2i &viewSize);
+
+    /// Draw all shapes submitted since the last flush
+    void flush();
+
+    /// Flush and stop accepting shapes
+    void end();
+
+    /// Return the number of shapes waiting to be flushed
+    size_t size() const { return mInstances.size(); }
+
+    /// Fill a rounded rectangle (in the current NanoVG transform) with a paint
+    void fill(NVGcontext *ctx, float x, float y, float w, float h, float r,
+              const NVGpaint &paint);
+
+    /// Stroke the outline of a rounded rectangle
+    void stroke(NVGcontext *ctx, float x, float y, float w, float h, float r,
+                const NVGpaint &paint, float width);
+
+    /// Fill the rectangle (x, y, w, h) minus a rounded hole, as used for drop shadows
+    void fillWithHole(NVGcontext *ctx, float x, float y, float w, float h,
+                      float hx, float hy, float hw, float hh, float hr,
+                      const NVGpaint &paint);
+
+    /**
+     * Draw a glyph quad (x, y, w, h) from a single-channel distance field
+     * texture, covering the texture rectangle \c uv (see \ref SDFText)
+     */
+    void glyph(NVGcontext *ctx, float x, float y, float w, float h, const float uv[4],
+               const NVGcolor &color, uint32_t texture);
+
+    /// Restrict subsequent shapes to a rectangle given in the current NanoVG transform
+    void scissor(NVGcontext *ctx, float x, float y, float w, float h);
+
+    /// Remove the scissor rectangle
+    void resetScissor() { mScissor = Vector4f(0.f, 0.f, -1.f, -1.f); }
+
+    /// Push the scissor state (mirrors \c nvgSave())
+    void save() { mScissorStack.push_back(mScissor); }
+
+    /// Pop the scissor state (mirrors \c nvgRestore())
+    void restore();
+
+protected:
+    PrimitiveBatch(NVGcontext *ctx);
+
+    /* Instance record, matches the layout set up in the constructor */
+    struct Instance {
+        float rect[4];        /* Shape rectangle (local coordinates) */
+        float shape[4];       /* Corner radius, stroke width (0: fill, < 0: glyph), hole radius, quad margin */
+        float hole[4];        /* Hole rectangle (w <= 0: none), atlas rectangle for glyphs */
+        float xform[4];       /* Current transform (a, b, c, d) */
+        float translate[4];   /* Current transform (e, f), paint radius, paint feather */
+        float paintXform[4];  /* Inverse paint transform (a, b, c, d) */
+        float paintExtent[4]; /* Inverse paint transform (e, f), paint extent */
+        float innerColor[4];  /* Premultiplied */
+        float outerColor[4];  /* Premultiplied */
+        float scissor[4];     /* Screen-space scissor (w < 0: none) */
+    };
+
+    Instance &push(NVGcontext *ctx, float x, float y, float w, float h, float r,
+                   const NVGpaint &paint, float margin);
+
+    NVGcontext *mContext;
+    GLShader *mShader;
+    bool mActive;
+    Vector2i mViewSize;
+    Vector4f mScissor;
+    std::vector<Vector4f> mScissorStack;
+    std::vector<Instance> mInstances;
+    uint32_t mGlyphTexture;
+};
+
+/// Fill a rounded rectangle through the \ref PrimitiveBatch when enabled, and with NanoVG otherwise
+extern NANOGUI_EXPORT void nvgBatchFillRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                                                   float r, const NVGpaint &paint);
+
+/// Fill a rounded rectangle with a solid color (see above)
+extern NANOGUI_EXPORT void nvgBatchFillRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                                                   float r, const NVGcolor &color);
+
+/// Stroke a rounded rectangle through the \ref PrimitiveBatch when enabled, and with NanoVG otherwise
+extern NANOGUI_EXPORT void nvgBatchStrokeRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                                                     float r, const NVGpaint &paint, float width = 1.0f);
+
+/// Stroke a rounded rectangle with a solid color (see above)
+extern NANOGUI_EXPORT void nvgBatchStrokeRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                                                     float r, const NVGcolor &color, float width = 1.0f);
+
+/// Fill a rectangle minus a rounded hole (e.g. a drop shadow), batched when enabled
+extern NANOGUI_EXPORT void nvgBatchFillRoundedRectHole(NVGcontext *ctx, float x, float y, float w, float h,
+                                                       float hx, float hy, float hw, float hh, float hr,
+                                                       const NVGpaint &paint);
+
+/// Set the scissor of both NanoVG and the \ref PrimitiveBatch
+extern NANOGUI_EXPORT void nvgBatchScissor(NVGcontext *ctx, float x, float y, float w, float h);
+
+/// Reset the scissor of both NanoVG and the \ref PrimitiveBatch
+extern NANOGUI_EXPORT void nvgBatchResetScissor(NVGcontext *ctx);
+
+/// Save the state of both NanoVG and the \ref PrimitiveBatch
+extern NANOGUI_EXPORT void nvgBatchSave(NVGcontext *ctx);
+
+/// Restore the state of both NanoVG and the \ref PrimitiveBatch
+extern NANOGUI_EXPORT void nvgBatchRestore(NVGcontext *ctx);
+
+NAMESPACE_END(nanogui)
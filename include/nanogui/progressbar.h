@@ -12,6 +12,8 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/telemetry.h>
+#include <memory>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -22,10 +24,24 @@ public:
     float value() { return mValue; }
     void setValue(float value) { mValue = value; }
 
+    /**
+     * Display an externally owned value, which is sampled every time the
+     * bar is drawn. The source may be written from any thread and must
+     * outlive the binding; a frame is requested when it differs from the
+     * value drawn last.
+     */
+    void bind(const std::atomic<float> &source);
+
+    /// Stop sampling the bound source (the last sampled value remains)
+    void unbind();
+
     virtual Vector2i preferredSize(NVGcontext *ctx);
     virtual void draw(NVGcontext* ctx);
 protected:
     float mValue;
+    const std::atomic<float> *mSource = nullptr;
+    std::atomic<float> mDrawnValue;
+    std::unique_ptr<TelemetryWatch> mWatch;
 };
 
 NAMESPACE_END(nanogui)
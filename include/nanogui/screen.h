@@ -14,9 +14,43 @@
 #pragma once
 
 #include <nanogui/widget.h>
+#include <nanogui/textlayout.h>
+#include <nanogui/taskqueue.h>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
 
 NAMESPACE_BEGIN(nanogui)
 
+class GLFramebufferPool;
+
+/**
+ * \brief Timestamped input event, as queued by \ref Screen
+ *
+ * The fields which are used depend on the type; positions and sizes are
+ * given in window coordinates, like the GLFW callback arguments.
+ */
+struct InputEvent {
+    enum class Type {
+        CursorPos,   ///< Cursor moved to (x, y)
+        MouseButton, ///< \c button changed to \c action
+        Key,         ///< \c key / \c scancode changed to \c action
+        Char,        ///< Text input of \c codepoint
+        Drop,        ///< \c filenames were dropped onto the window
+        Scroll,      ///< Scroll offset (x, y)
+        Resize       ///< Framebuffer resized to (x, y)
+    };
+
+    Type type;
+    double time = 0;        ///< Time of arrival (\c glfwGetTime())
+    double x = 0, y = 0;
+    int button = 0, key = 0, scancode = 0, action = 0, modifiers = 0;
+    unsigned int codepoint = 0;
+    std::vector<std::string> filenames;
+};
+
 /**
  * \brief Represents a display surface (i.e. a full-screen or windowed GLFW window)
  * and forms the root element of a hierarchy of nanogui widgets
@@ -25,9 +59,17 @@ class NANOGUI_EXPORT Screen : public Widget {
     friend class Widget;
     friend class Window;
 public:
-    /// Create a new screen
+    /**
+     * Create a new screen. If \c share is given, the GL context of the new
+     * screen shares objects with that of \c share, and the new screen
+     * uses the same \ref Theme and the same icon images and
+     * \ref ImageAtlas textures instead of uploading its own copies. NanoVG
+     * keeps a font atlas per context, so only the font faces are
+     * registered again, without copying the font data. \c share must be
+     * destroyed after the new screen.
+     */
     Screen(const Vector2i &size, const std::string &caption,
-           bool resizable = true, bool fullscreen = false);
+           bool resizable = true, bool fullscreen = false, Screen *share = nullptr);
 
     /// Release all resources
     virtual ~Screen();
@@ -47,12 +89,59 @@ public:
     /// Set the top-level window visibility (no effect on full-screen windows)
     void setVisible(bool visible);
 
-    /// Set window size
+    /// Set window size (in logical units, see \ref setUIScale())
     void setSize(const Vector2i& size);
 
+    /**
+     * Scale the whole interface (fonts, theme metrics and layouts) by
+     * \c scale, independently of the framebuffer pixel ratio. Widgets keep
+     * working in logical units, so existing layouts remain valid and no
+     * relayout is needed. Window placements are remembered per scale and
+     * restored when switching back to a scale used before.
+     */
+    void setUIScale(float scale);
+
+    /// Return the interface scale factor
+    float uiScale() const { return mUIScale; }
+
+    /// Return the number of framebuffer pixels per logical unit
+    float pixelRatio() const { return mPixelRatio; }
+
+    /// Return the content scale of the monitor the window is on (1 before GLFW 3.3)
+    const Vector2f &contentScale() const { return mContentScale; }
+
+    /**
+     * Run \c task on the main thread before the next frame of this screen
+     * is drawn. Safe to call from any thread; wakes up the main loop. With
+     * \ref setThreadedRendering(), tasks run on the event thread without a
+     * current OpenGL context.
+     */
+    void post(std::function<void()> task);
+
     /// Draw the Screen contents
     virtual void drawAll();
 
+    /**
+     * Hand OpenGL submission and buffer swaps to a dedicated render thread,
+     * so that a swap blocking on vsync or a slow GPU no longer delays event
+     * processing. \ref drawAll() then only requests a frame; the render
+     * thread draws the widgets (and \ref drawContents()) while holding
+     * \ref uiLock(), which event handling and posted tasks also hold, and
+     * swaps after releasing it. The OpenGL context belongs to the render
+     * thread while this is enabled. Since this may be called while holding
+     * the UI lock, disabling only asks the render thread to stop; it is
+     * joined (and the context returned to the main thread) when the main
+     * loop next processes this screen, until then \ref threadedRendering()
+     * still reports \c true.
+     */
+    void setThreadedRendering(bool enabled);
+
+    /// Return whether a dedicated render thread is used
+    bool threadedRendering() const { return mThreadedRendering; }
+
+    /// Lock guarding the widget tree against the render thread
+    std::recursive_mutex &uiLock() { return mUILock; }
+
     /// Draw the window contents -- put your OpenGL draw calls here
     virtual void drawContents() { /* To be overridden */ }
 
@@ -80,10 +169,136 @@ public:
     void setShutdownGLFWOnDestruct(bool v) { mShutdownGLFWOnDestruct = v; }
     bool shutdownGLFWOnDestruct() { return mShutdownGLFWOnDestruct; }
 
+    /// Receives a captured frame as top-down RGBA8 rows at framebuffer resolution
+    typedef std::function<void(const Vector2i &size, const uint8_t *rgba)> FrameCallback;
+
+    /**
+     * Capture the next rendered frame (including widgets) without stalling
+     * the pipeline. \c callback is invoked one or two frames later; calling
+     * this again from within the callback streams consecutive frames.
+     */
+    void captureFrameAsync(const FrameCallback &callback);
+
+    /**
+     * Return the pool for offscreen render targets of this screen's context.
+     * Released framebuffers are collected once per frame by \ref drawAll().
+     */
+    GLFramebufferPool &framebufferPool();
+
+    /**
+     * Draw rounded-rectangle widget chrome through the instanced
+     * \ref PrimitiveBatch instead of NanoVG paths (disabled by default)
+     */
+    void setBatchedPrimitives(bool enabled) { mBatchedPrimitives = enabled; }
+
+    /// Return whether widget chrome is drawn through the \ref PrimitiveBatch
+    bool batchedPrimitives() const { return mBatchedPrimitives; }
+
+    /**
+     * Draw label text from a distance field atlas (see \ref SDFText), so
+     * that it stays sharp at any scale without rasterizing new glyphs.
+     * Requires batched primitives (disabled by default).
+     */
+    void setSDFText(bool enabled);
+
+    /// Return whether label text is drawn from a distance field atlas
+    bool sdfText() const;
+
+    /**
+     * Skip windows which are completely hidden behind the opaque regions of
+     * windows in front of them (enabled by default, see
+     * \ref Window::opaqueRegion()). The default theme fills windows with a
+     * slightly translucent color, so only title bars occlude and windows are
+     * rarely skipped; themes with opaque window fills benefit the most.
+     */
+    void setOcclusionCulling(bool enabled) { mOcclusionCulling = enabled; }
+
+    /// Return whether hidden windows are skipped while drawing
+    bool occlusionCulling() const { return mOcclusionCulling; }
+
+    /**
+     * Lay out the top-level windows concurrently on a \ref LayoutPool
+     * (disabled by default). Windows are independent of each other, hence
+     * every window subtree is measured and arranged by one worker, which
+     * pays off after changes that affect many windows at once, such as a
+     * theme or scale change. \ref performLayout() still returns only once
+     * all windows are done.
+     *
+     * Workers measure text with NanoVG contexts of their own, which only
+     * know the theme fonts and those loaded through \ref createFont() or
+     * \ref createFontMem(); fonts created directly with NanoVG measure as
+     * empty. Images cannot be created while layout runs, hence icons used
+     * by \c preferredSize() must be loaded beforehand.
+     */
+    void setParallelLayout(bool enabled) { mParallelLayout = enabled; }
+
+    /// Return whether top-level windows are laid out concurrently
+    bool parallelLayout() const { return mParallelLayout; }
+
+    /// Load a font file into the NanoVG context and the layout workers, return its handle
+    int createFont(const std::string &name, const std::string &filename);
+
+    /**
+     * Load a font from memory into the NanoVG context and the layout
+     * workers, return its handle. The data is not copied and must remain
+     * valid for the lifetime of the screen.
+     */
+    int createFontMem(const std::string &name, const uint8_t *data, size_t size);
+
     /// Compute the layout of all widgets
-    void performLayout() {
-        Widget::performLayout(mNVGContext);
-    }
+    void performLayout();
+
+    /**
+     * Queue input events from GLFW and dispatch them once per frame
+     * (enabled by default). Consecutive cursor motions are merged into a
+     * single one (whose relative motion is the accumulated one), as are
+     * consecutive scroll offsets and resizes, so that high polling rate
+     * devices do not cause a full dispatch per raw event. When disabled,
+     * every event is dispatched as soon as GLFW reports it.
+     */
+    void setInputQueueing(bool enabled);
+
+    /// Return whether input events are queued until the next frame
+    bool inputQueueing() const { return mInputQueueing; }
+
+    /**
+     * Queue a batch of events (main thread only), e.g. from a host
+     * application which manages GLFW itself (see \ref initialize()). They
+     * are merged like GLFW events and dispatched by the next \ref drawAll()
+     * or \ref dispatchEvents(); with queueing disabled, they are
+     * dispatched right away.
+     */
+    void injectEvents(const std::vector<InputEvent> &events);
+
+    /// Dispatch all queued input events
+    void dispatchEvents();
+
+    /**
+     * Set the rate at which \ref mainloop() draws this screen at most
+     * while it is unfocused and has seen no input for a second. Values
+     * <= 0 select the rate of the \ref PowerPolicy (unlimited, 10 or 2
+     * frames per second). Iconified screens are not drawn at all.
+     */
+    void setBackgroundFrameRate(float fps) { mBackgroundFrameRate = fps; }
+
+    /// Return the background frame rate (<= 0: given by the power policy)
+    float backgroundFrameRate() const { return mBackgroundFrameRate; }
+
+    /// Return whether the window is iconified
+    bool iconified() const { return mIconified; }
+
+    /// Return whether the window has the input focus
+    bool windowFocused() const { return mWindowFocused; }
+
+    /**
+     * Return the time in seconds until the screen should be drawn again:
+     * 0 if it can be drawn now, and a negative value if it should not be
+     * drawn (iconified). Used by \ref mainloop().
+     */
+    double frameDelay() const;
+
+    /// Dispatch queued input and run posted tasks without drawing (called by \ref drawAll())
+    void runPending();
 public:
     /********* API for applications which manage GLFW themselves *********/
 
@@ -101,8 +316,12 @@ public:
      */
     Screen();
 
-    /// Initialize the \ref Screen
-    void initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct);
+    /**
+     * Initialize the \ref Screen. If \c share is given, \c window must
+     * have been created with a GL context sharing objects with that of
+     * \c share (see the \ref Screen constructor).
+     */
+    void initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct, Screen *share = nullptr);
 
     /* Event handlers */
     bool cursorPosCallbackEvent(double x, double y);
@@ -112,6 +331,8 @@ public:
     bool dropCallbackEvent(int count, const char **filenames);
     bool scrollCallbackEvent(double x, double y);
     bool resizeCallbackEvent(int width, int height);
+    bool iconifyCallbackEvent(bool iconified);
+    bool focusCallbackEvent(bool focused);
 
     /* Internal helper functions */
     void updateFocus(ref<Widget> widget);
@@ -119,6 +340,14 @@ public:
     void centerWindow(ref<Window> window);
     void moveWindowToFront(ref<Window> window);
     void drawWidgets();
+    void collectDrawList(std::vector<Widget *> &drawList);
+    void queryMetrics();
+    void updateSize();
+    void renderFrame();
+    void renderLoop();
+    void syncRenderThread();
+    void queueEvent(const InputEvent &event);
+    void dispatchEvent(const InputEvent &event);
 
     void performLayout(NVGcontext *ctx) {
         Widget::performLayout(ctx);
@@ -131,6 +360,9 @@ protected:
     Cursor mCursor;
     std::vector<ref<Widget> > mFocusPath;
     Vector2i mFBSize;
+    Vector2i mWindowSize = Vector2i(0);
+    Vector2f mContentScale = Vector2f(1.f);
+    bool mTrackMetrics = false; /* Metrics are kept up to date by our GLFW callbacks */
     float mPixelRatio;
     int mMouseState, mModifiers;
     Vector2i mMousePos;
@@ -141,6 +373,29 @@ protected:
     Vector3f mBackground;
     std::string mCaption;
     bool mShutdownGLFWOnDestruct;
+    std::vector<FrameCallback> mFrameCaptures;
+    std::unique_ptr<GLFramebufferPool> mFramebufferPool;
+    bool mBatchedPrimitives = false;
+    bool mOcclusionCulling = true;
+    bool mParallelLayout = false;
+    bool mInputQueueing = true;
+    bool mIconified = false, mWindowFocused = true;
+    float mBackgroundFrameRate = 0.f;
+    double mLastFrameTime = 0;
+    std::vector<InputEvent> mEvents;
+    std::vector<Widget *> mDrawList;
+    TextLayout mTooltipLayout;
+    float mUIScale = 1.f;
+    TaskQueue mTasks;
+    std::recursive_mutex mUILock;
+    bool mThreadedRendering = false;
+    std::thread mRenderThread;
+    std::mutex mFrameMutex;
+    std::condition_variable mFrameCond;
+    bool mFrameRequested = false, mStopRender = false;
+    bool mRenderThreadWanted = false;
+    /* Top-level widget placements (position, size) saved per UI scale */
+    std::map<float, std::vector<std::pair<weakref<Widget>, Vector4i>>> mScalePlacements;
 };
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,119 @@
+/*
+    nanogui/sdftext.h -- Signed distance field glyph atlas for text that
+    renders at any size and zoom level from a single texture
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/opengl.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+NAMESPACE_BEGIN(nanogui)
+
+class PrimitiveBatch;
+
+/**
+ * \brief Signed distance field text renderer
+ *
+ * Every glyph is rasterized once at a fixed base size and converted into a
+ * distance field, which the \ref PrimitiveBatch shader turns back into
+ * antialiased coverage at any size and under any transform. Text can thus
+ * be scaled smoothly without new bitmaps, and the memory use is bounded by
+ * a single atlas texture.
+ *
+ * SDF text is only used while it is enabled and the \ref PrimitiveBatch is
+ * active (see \ref Screen::setSDFText()); \ref nvgBatchText() falls back to
+ * NanoVG otherwise. \ref Theme registers its text fonts automatically.
+ */
+class NANOGUI_EXPORT SDFText {
+public:
+    /// Width and height of the atlas texture
+    enum { AtlasSize = 1024 };
+
+    /// Pixel height at which glyphs are rasterized
+    enum { BaseSize = 48 };
+
+    /// Distance (in pixels at the base size) covered by the field on each side of an outline
+    enum { Spread = 6 };
+
+    /// Return the SDF text renderer of a NanoVG context, creating it if needed
+    static SDFText &get(NVGcontext *ctx);
+
+    /// Return the SDF text renderer of a NanoVG context if one was created
+    static SDFText *find(NVGcontext *ctx);
+
+    /// Destroy the renderer of a NanoVG context (requires its GL context to be current)
+    static void release(NVGcontext *ctx);
+
+    ~SDFText();
+
+    /// Enable or disable SDF text rendering
+    void setEnabled(bool enabled) { mEnabled = enabled; }
+
+    /// Return whether SDF text rendering is enabled
+    bool enabled() const { return mEnabled; }
+
+    /**
+     * Register a TrueType font under the same name as used with NanoVG. The
+     * font data is not copied and must remain valid.
+     */
+    bool addFont(const std::string &name, const uint8_t *data, size_t size);
+
+    /// Return whether a font was registered under \c name
+    bool hasFont(const std::string &name) const { return mFonts.find(name) != mFonts.end(); }
+
+    /// Return the advance width of a string
+    float textWidth(const std::string &font, float size, const char *string, const char *end = nullptr);
+
+    /**
+     * Submit a string to \c batch at (x, y) in the current NanoVG transform,
+     * aligned like \c nvgText(). Returns the horizontal position after the
+     * last glyph.
+     */
+    float draw(PrimitiveBatch &batch, const std::string &font, float size, float x, float y,
+               int align, const NVGcolor &color, const char *string, const char *end = nullptr);
+
+protected:
+    SDFText(NVGcontext *ctx);
+
+    struct Font;
+
+    struct Glyph {
+        float x0, y0, w, h; /* Quad relative to the pen position, at the base size */
+        float uv[4];        /* Atlas coordinates (u0, v0, u1, v1); w == 0: nothing to draw */
+    };
+
+    const Glyph &glyph(Font &font, int index, PrimitiveBatch &batch);
+    bool allocate(int w, int h, int &x, int &y);
+    float layout(Font &font, float size, const char *string, const char *end,
+                 const std::function<void(int, float)> &callback);
+
+    NVGcontext *mContext;
+    bool mEnabled = false;
+    GLuint mTexture = 0;
+    std::map<std::string, std::unique_ptr<Font>> mFonts;
+    std::map<std::pair<const Font *, int>, Glyph> mGlyphs;
+    int mShelfX = 0, mShelfY = 0, mShelfHeight = 0;
+};
+
+/**
+ * Draw text with an explicit font, size, alignment and color. Uses the
+ * \ref SDFText renderer when it is enabled and the \ref PrimitiveBatch is
+ * active, and \c nvgText() otherwise. Returns the horizontal position after
+ * the last glyph.
+ */
+extern NANOGUI_EXPORT float nvgBatchText(NVGcontext *ctx, float x, float y, const std::string &font,
+                                         float size, int align, const NVGcolor &color,
+                                         const char *string, const char *end = nullptr);
+
+NAMESPACE_END(nanogui)
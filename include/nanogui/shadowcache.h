@@ -0,0 +1,72 @@
+/*
+    nanogui/shadowcache.h -- Precomputed 9-slice drop shadow textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+#include <map>
+#include <tuple>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Caches window drop shadows as 9-slice textures
+ *
+ * The shadow of a rounded rectangle only depends on the corner radius, the
+ * shadow size and its color, so it is rendered once on the CPU (using the
+ * same box gradient as NanoVG) and then drawn as eight textured quads: four
+ * corners and four stretched edges, with the interior left out since the
+ * window covers it.
+ */
+class NANOGUI_EXPORT ShadowCache {
+public:
+    /// Return the shadow cache of a NanoVG context, creating it if needed
+    static ShadowCache &get(NVGcontext *ctx);
+
+    /// Destroy the shadow cache of a NanoVG context (before the context is deleted)
+    static void release(NVGcontext *ctx);
+
+    ~ShadowCache();
+
+    /**
+     * Draw the shadow of the rounded rectangle (x, y, w, h) with corner
+     * radius \c cr, extending \c ds pixels outwards. Returns \c false
+     * without drawing anything if the rectangle is too small for the
+     * corner slices, in which case the caller should draw a path instead.
+     */
+    bool draw(float x, float y, float w, float h, int cr, int ds, const NVGcolor &color);
+
+    /// Delete all cached textures
+    void clear();
+
+protected:
+    ShadowCache(NVGcontext *ctx) : mContext(ctx) { }
+
+    /* Corner radius, shadow size, 8 bit RGBA color */
+    typedef std::tuple<int, int, uint32_t> Key;
+
+    int image(int cr, int ds, const NVGcolor &color);
+
+    NVGcontext *mContext;
+    std::map<Key, int> mImages;
+};
+
+/**
+ * Draw the drop shadow of a rounded rectangle, fading from \c color to
+ * transparent over \c ds pixels. Uses the \ref PrimitiveBatch when it is
+ * active, the \ref ShadowCache otherwise, and falls back to a NanoVG path
+ * for rectangles that are too small to be sliced.
+ */
+extern NANOGUI_EXPORT void nvgDropShadow(NVGcontext *ctx, float x, float y, float w, float h,
+                                         int cr, int ds, const NVGcolor &color);
+
+NAMESPACE_END(nanogui)
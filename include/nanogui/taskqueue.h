@@ -0,0 +1,64 @@
+/*
+    nanogui/taskqueue.h -- Lock-free queue for running work posted from
+    other threads on the UI thread
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <atomic>
+#include <functional>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Multi-producer, single-consumer task queue
+ *
+ * Any thread may \ref push() tasks without taking a lock (a single atomic
+ * exchange per task); the UI thread runs them with \ref run(). Used by
+ * \ref Screen::post() and \ref nanogui::post().
+ */
+class NANOGUI_EXPORT TaskQueue {
+public:
+    typedef std::function<void()> Task;
+
+    TaskQueue();
+    ~TaskQueue();
+
+    TaskQueue(const TaskQueue &) = delete;
+    TaskQueue &operator=(const TaskQueue &) = delete;
+
+    /// Append a task (safe to call from any thread)
+    void push(Task task);
+
+    /// Remove the oldest task, returns \c false if there is none (consumer thread only)
+    bool pop(Task &task);
+
+    /**
+     * Run queued tasks in order until the queue is empty or \c budget
+     * seconds have passed (consumer thread only). Returns the number of
+     * tasks that were run.
+     */
+    size_t run(double budget);
+
+    /// Return whether the queue is empty (consumer thread only)
+    bool empty() const { return mTail->next.load(std::memory_order_acquire) == nullptr; }
+
+protected:
+    struct Node {
+        std::atomic<Node *> next;
+        Task task;
+    };
+
+    std::atomic<Node *> mHead; /* Most recently pushed node, shared by producers */
+    Node *mTail;               /* Already consumed node in front of the oldest task */
+};
+
+NAMESPACE_END(nanogui)
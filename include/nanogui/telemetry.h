@@ -0,0 +1,108 @@
+/*
+    nanogui/telemetry.h -- Lock-free sources that widgets sample once per
+    frame, and change detection to request frames for them
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Fixed-size single-producer, single-consumer ring buffer
+ *
+ * One thread may \ref push() values and another one may \ref pop() them
+ * without locking. Used to feed a \ref Graph from a worker thread; values
+ * pushed while the buffer is full are dropped.
+ */
+template <typename T> class RingBuffer {
+public:
+    RingBuffer(size_t capacity) : mData(capacity + 1), mHead(0), mTail(0) { }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    /// Append a value (producer thread only), returns \c false if the buffer is full
+    bool push(const T &value) {
+        size_t head = mHead.load(std::memory_order_relaxed);
+        size_t next = (head + 1) % mData.size();
+        if (next == mTail.load(std::memory_order_acquire))
+            return false;
+        mData[head] = value;
+        mHead.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /// Remove the oldest value (consumer thread only), returns \c false if there is none
+    bool pop(T &value) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire))
+            return false;
+        value = mData[tail];
+        mTail.store((tail + 1) % mData.size(), std::memory_order_release);
+        return true;
+    }
+
+    /// Return whether the buffer is empty (any thread, may be outdated immediately)
+    bool empty() const {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+
+    /// Return the maximum number of values the buffer holds
+    size_t capacity() const { return mData.size() - 1; }
+
+protected:
+    std::vector<T> mData;
+    std::atomic<size_t> mHead; /* Next slot written by the producer */
+    std::atomic<size_t> mTail; /* Next slot read by the consumer */
+};
+
+/**
+ * \brief Change detection for widgets bound to externally owned values
+ *
+ * A bound widget samples its source while drawing and keeps a watch whose
+ * predicate compares the source against the value drawn last. The
+ * predicates must be safe to call from any thread. \ref mainloop() polls
+ * all watches from its refresh thread and requests a frame only when one
+ * of them reports a change; applications with their own loop can call
+ * \ref poll() themselves.
+ *
+ * A watch reports a change once and then stays silent until the widget
+ * calls \ref rearm() while drawing. Widgets which are not drawn (hidden,
+ * occlusion culled, or on an iconified or throttled screen) therefore
+ * cannot keep requesting frames for values they never consume.
+ */
+class NANOGUI_EXPORT TelemetryWatch {
+public:
+    /// Register a change predicate
+    TelemetryWatch(const std::function<bool()> &changed);
+
+    /// Unregister the predicate; it is not called anymore once this returns
+    ~TelemetryWatch();
+
+    TelemetryWatch(const TelemetryWatch &) = delete;
+    TelemetryWatch &operator=(const TelemetryWatch &) = delete;
+
+    /// Report changes again, called by the widget after sampling its source
+    void rearm() { mArmed.store(true, std::memory_order_release); }
+
+    /// Return whether any armed predicate reports a change and disarm those (any thread)
+    static bool poll();
+
+protected:
+    std::function<bool()> mChanged;
+    std::atomic<bool> mArmed;
+};
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,67 @@
+/*
+    nanogui/textlayout.h -- Cached line breaking for wrapped paragraphs
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <nanogui/common.h>
+#include <nanovg.h>
+#include <string>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/**
+ * \brief Wrapped paragraph whose line breaks are computed once
+ *
+ * Equivalent to \c nvgTextBox() and \c nvgTextBoxBounds() with top
+ * alignment, except that the text is only broken into lines again when the
+ * text, font, size, wrapping width or line height change. Widgets keep one
+ * instance per paragraph and call \ref update() before measuring or drawing.
+ */
+class NANOGUI_EXPORT TextLayout {
+public:
+    /**
+     * Select the font and re-break the text if any of the parameters
+     * changed since the last call. Returns \c true if the layout changed.
+     */
+    bool update(NVGcontext *ctx, const std::string &text, const std::string &font,
+                float fontSize, float width, float lineHeight = 1.f);
+
+    /// Compute the bounds of the paragraph at (x, y) like \c nvgTextBoxBounds()
+    void bounds(float x, float y, int align, float *bounds) const;
+
+    /// Draw the paragraph at (x, y) like \c nvgTextBox(); horizontal alignment is taken from \c align
+    void draw(NVGcontext *ctx, float x, float y, int align) const;
+
+    /// Return the number of lines
+    size_t lineCount() const { return mLines.size(); }
+
+    /// Force the next \ref update() to break the text again
+    void invalidate() { mValid = false; }
+
+protected:
+    struct Line {
+        size_t start, end;
+        float width, minx, maxx;
+    };
+
+    float lineOffset(const Line &line, int align) const;
+
+    std::string mText, mFont;
+    float mFontSize = 0, mWidth = 0, mLineHeight = 0;
+    bool mValid = false;
+
+    std::vector<Line> mLines;
+    float mAdvance = 0;          /* Distance between consecutive baselines */
+    float mRowMinY = 0, mRowMaxY = 0; /* Vertical extent of a line relative to its top */
+};
+
+NAMESPACE_END(nanogui)
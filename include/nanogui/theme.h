@@ -22,6 +22,12 @@ class NANOGUI_EXPORT Theme : public std::enable_shared_from_this<Theme> {
 public:
     Theme(NVGcontext *ctx);
 
+    /**
+     * Register the theme fonts with another NanoVG context, so that screens
+     * can share a theme. The font data is not copied.
+     */
+    void registerFonts(NVGcontext *ctx);
+
     /* Fonts */
     int mFontNormal;
     int mFontBold;
@@ -12,6 +12,7 @@
 #pragma once
 
 #include <nanogui/object.h>
+#include <nanogui/async.h>
 #include <vector>
 #include <nanovg.h>
 #include <atomic>
@@ -162,6 +163,24 @@ public:
     /// Request the focus to be moved to this widget
     void requestFocus();
 
+    /**
+     * \brief Run \c work on the shared \ref WorkerPool
+     *
+     * Once \c work has returned, \c onDone is called on the main thread
+     * (through \ref nanogui::post()) unless the widget no longer exists or
+     * the task was cancelled. Tasks are cancelled when the widget is
+     * destroyed, when its window is disposed (\ref Window::dispose(),
+     * \ref Screen::disposeWindow()) and by \ref cancelAsync(). Cancellation
+     * is cooperative: \c work should poll the token it receives and return
+     * early, and must not access the widget. Not to be called from a
+     * widget constructor.
+     */
+    CancelToken runAsync(const std::function<void(const CancelToken &)> &work,
+                         const std::function<void()> &onDone = nullptr);
+
+    /// Cancel the pending tasks of this widget and all of its children
+    void cancelAsync();
+
     const std::string &tooltip() const { return mTooltip; }
     void setTooltip(const std::string &tooltip) { mTooltip = tooltip; }
 
@@ -243,6 +262,7 @@ protected:
     std::string mTooltip;
     int mFontSize;
     Cursor mCursor;
+    std::vector<CancelToken> mAsyncTasks;
 
 	static std::atomic<int> idCounter;
 };
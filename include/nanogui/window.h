@@ -39,6 +39,15 @@ public:
     /// Draw the window
     virtual void draw(NVGcontext *ctx) override;
 
+    /**
+     * Return a rectangle (in parent coordinates) that this window covers
+     * with fully opaque pixels, or \c false if there is none. Used by
+     * \ref Screen to skip windows hidden behind others. This is the whole
+     * window when the theme's window fill is opaque, and otherwise only the
+     * title bar (the default theme uses a slightly translucent fill).
+     */
+    virtual bool opaqueRegion(Vector2i &pos, Vector2i &size) const;
+
 	std::function<bool()> closeCallback() const { return mCloseCallback; }
 	void setCloseCallback(std::function<bool()> callback) { mCloseCallback = callback; }
 
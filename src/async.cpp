@@ -0,0 +1,72 @@
+/*
+    src/async.cpp -- Shared worker threads for background work started
+    from widgets, with cooperative cancellation
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/async.h>
+#include <algorithm>
+#include <iostream>
+
+NAMESPACE_BEGIN(nanogui)
+
+WorkerPool &WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        mStop = true;
+        mQueue.clear();
+    }
+    mCond.notify_all();
+    for (auto &worker : mWorkers)
+        worker.join();
+}
+
+int WorkerPool::threadCount() const {
+    return std::max((int) std::thread::hardware_concurrency(), 2);
+}
+
+void WorkerPool::start() {
+    for (int i = 0; i < threadCount(); ++i) {
+        mWorkers.push_back(std::thread([this]() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mCond.wait(lock, [this]() { return mStop || !mQueue.empty(); });
+                    if (mStop)
+                        return;
+                    task = std::move(mQueue.front());
+                    mQueue.pop_front();
+                }
+                try {
+                    task();
+                } catch (const std::exception &e) {
+                    std::cerr << "Caught exception in background task: " << e.what() << std::endl;
+                }
+            }
+        }));
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        if (mWorkers.empty())
+            start();
+        mQueue.push_back(std::move(task));
+    }
+    mCond.notify_one();
+}
+
+NAMESPACE_END(nanogui)
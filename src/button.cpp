@@ -13,6 +13,8 @@
 #include <nanogui/button.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/primitivebatch.h>
 #include <iostream>
 
 NAMESPACE_BEGIN(nanogui)
@@ -38,7 +40,7 @@ Vector2i Button::preferredSize(NVGcontext *ctx) {
             iw = textBounds + (textBounds * 0.15f);
         } else {
             int w, h;
-            nvgImageSize(ctx, mIcon, &w, &h);
+            nvgImageIconSize(ctx, mIcon, &w, &h);
             iw = w * ih / h;
         }
     }
@@ -131,14 +133,10 @@ void Button::draw(NVGcontext *ctx) {
         gradBot = mTheme->mButtonGradientBotFocused;
     }
 
-    nvgBeginPath(ctx);
-
-    nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x - 2,
-                   mSize.y - 2, mTheme->mButtonCornerRadius - 1);
-
     if (mBackgroundColor.a != 0) {
-        nvgFillColor(ctx, Color(mBackgroundColor.rgb(), 1.f));
-        nvgFill(ctx);
+        nvgBatchFillRoundedRect(ctx, mPos.x, mPos.y, mSize.x - 2, mSize.y - 2,
+                                mTheme->mButtonCornerRadius - 1,
+                                Color(mBackgroundColor.rgb(), 1.f));
         if (mPushed) {
             gradTop.a = gradBot.a = 0.8f;
         } else {
@@ -150,20 +148,15 @@ void Button::draw(NVGcontext *ctx) {
     NVGpaint bg = nvgLinearGradient(ctx, mPos.x, mPos.y, mPos.x,
                                     mPos.y + mSize.y, gradTop, gradBot);
 
-    nvgFillPaint(ctx, bg);
-    nvgFill(ctx);
+    nvgBatchFillRoundedRect(ctx, mPos.x, mPos.y, mSize.x - 2, mSize.y - 2,
+                            mTheme->mButtonCornerRadius - 1, bg);
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x + 0.5f, mPos.y + (mPushed ? 0.5f : 1.5f), mSize.x - 1,
-                   mSize.y - 1 - (mPushed ? 0.0f : 1.0f), mTheme->mButtonCornerRadius);
-    nvgStrokeColor(ctx, mTheme->mBorderLight);
-    nvgStroke(ctx);
+    nvgBatchStrokeRoundedRect(ctx, mPos.x + 0.5f, mPos.y + (mPushed ? 0.5f : 1.5f), mSize.x - 1,
+                              mSize.y - 1 - (mPushed ? 0.0f : 1.0f), mTheme->mButtonCornerRadius,
+                              mTheme->mBorderLight);
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x + 0.5f, mPos.y + 0.5f, mSize.x - 1,
-                   mSize.y - 2, mTheme->mButtonCornerRadius);
-    nvgStrokeColor(ctx, mTheme->mBorderDark);
-    nvgStroke(ctx);
+    nvgBatchStrokeRoundedRect(ctx, mPos.x + 0.5f, mPos.y + 0.5f, mSize.x - 1,
+                              mSize.y - 2, mTheme->mButtonCornerRadius, mTheme->mBorderDark);
 
     int fontSize = mFontSize == -1 ? mTheme->mButtonFontSize : mFontSize;
     nvgFontSize(ctx, fontSize);
@@ -186,7 +179,7 @@ void Button::draw(NVGcontext *ctx) {
             iw = nvgTextBounds(ctx, 0, 0, icon.data(), nullptr, nullptr);
         } else {
             int w, h;
-            nvgImageSize(ctx, mIcon, &w, &h);
+            nvgImageIconSize(ctx, mIcon, &w, &h);
             iw = w * ih / h;
         }
         if (mCaption != "")
@@ -211,9 +204,12 @@ void Button::draw(NVGcontext *ctx) {
         if (nvgIsFontIcon(mIcon)) {
             nvgText(ctx, iconPos.x, iconPos.y, icon.data(), nullptr);
         } else {
-            NVGpaint imgPaint = nvgImagePattern(ctx,
-                    iconPos.x, iconPos.y - ih/2, iw, ih, 0, mIcon, mEnabled ? 0.5f : 0.25f);
+            NVGpaint imgPaint = nvgImageIconPattern(ctx, mIcon,
+                    iconPos.x, iconPos.y - ih/2, iw, ih, mEnabled ? 0.5f : 0.25f);
 
+            /* Restrict the fill to the icon, atlas pages contain other images */
+            nvgBeginPath(ctx);
+            nvgRect(ctx, iconPos.x, iconPos.y - ih/2, iw, ih);
             nvgFillPaint(ctx, imgPaint);
             nvgFill(ctx);
         }
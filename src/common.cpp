@@ -16,7 +16,13 @@
 #include <windows.h>
 #endif
 #include <nanogui/opengl.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/layoutpool.h>
+#include <nanogui/taskqueue.h>
+#include <nanogui/telemetry.h>
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <thread>
 #include <chrono>
 #include <iostream>
@@ -30,6 +36,27 @@
 NAMESPACE_BEGIN(nanogui)
 
 static bool __mainloop_active = false;
+static std::atomic<int> __power_policy((int) PowerPolicy::Balanced);
+
+/* Time (glfwGetTime()) at which a throttled screen is due for its next
+   frame; the refresh thread wakes up the main loop then. -1: none */
+static std::atomic<double> __wake_time(-1.0);
+/* Whether any screen drew in the last iteration of the main loop */
+static std::atomic<bool> __screens_drawing(true);
+static TaskQueue __nanogui_tasks;
+static TaskQueue __nanogui_frame_tasks;
+
+/* Tasks from nanogui::postDelayed(), ordered by due time */
+static std::mutex __nanogui_timer_mutex;
+static std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> __nanogui_timers;
+
+/* Seconds per main loop iteration spent on tasks from nanogui::post() */
+static const double __task_budget = 0.005;
+
+/* Milliseconds between two checks of the values bound to widgets (and of
+   due timers), normally and with PowerPolicy::Saver */
+static const int __telemetry_interval = 16;
+static const int __telemetry_interval_saver = 100;
 extern std::map<GLFWwindow *, Screen *> __nanogui_screens;
 
 void init() {
@@ -50,26 +77,72 @@ void init() {
     glfwSetTime(0);
 }
 
+/* Lock the UI of every screen (in a fixed order), so that tasks from
+   nanogui::post() and friends never run while a render thread walks one of
+   the widget trees */
+static std::vector<std::unique_lock<std::recursive_mutex>> lock_screens_helper() {
+    std::vector<std::unique_lock<std::recursive_mutex>> locks;
+    for (auto kv : __nanogui_screens)
+        locks.emplace_back(kv.second->uiLock());
+    return locks;
+}
+
+/* Move timers which are due into the task queue, returns whether there were any */
+static bool post_due_timers_helper() {
+    std::lock_guard<std::mutex> guard(__nanogui_timer_mutex);
+    auto now = std::chrono::steady_clock::now();
+    bool due = false;
+    while (!__nanogui_timers.empty() && __nanogui_timers.begin()->first <= now) {
+        __nanogui_tasks.push(std::move(__nanogui_timers.begin()->second));
+        __nanogui_timers.erase(__nanogui_timers.begin());
+        due = true;
+    }
+    return due;
+}
+
 void mainloop() {
     __mainloop_active = true;
 
-    /* If there are no mouse/keyboard events, try to refresh the
-       view roughly every 50 ms; this is to support animations
+    /* If there are no mouse/keyboard events, check roughly every
+       16 ms whether a value bound to a widget has changed, and only
+       refresh the view in that case; this is to support telemetry
        such as progress bars while keeping the system load
        reasonably low */
     std::thread refresh_thread = std::thread(
         [&]() {
-            std::chrono::milliseconds time(50);
             while (__mainloop_active) {
+                std::chrono::milliseconds time(powerPolicy() == PowerPolicy::Saver
+                    ? __telemetry_interval_saver : __telemetry_interval);
                 std::this_thread::sleep_for(time);
-                //glfwPostEmptyEvent();
+                bool due = post_due_timers_helper();
+                double wake = __wake_time.load();
+                if (wake >= 0 && glfwGetTime() >= wake) {
+                    __wake_time = -1.0;
+                    due = true;
+                }
+                /* Waking up for changed values is pointless while every
+                   screen is iconified or throttled: they only draw again at
+                   __wake_time or on input, and a throttled screen then gets
+                   at most one extra wakeup per frame */
+                bool changed = __screens_drawing.load() && TelemetryWatch::poll();
+                if (changed || due)
+                    glfwPostEmptyEvent();
             }
         }
     );
 
     try {
         while (__mainloop_active) {
+            {
+                auto locks = lock_screens_helper();
+                __nanogui_tasks.run(__task_budget);
+            }
+            if (!__nanogui_tasks.empty())
+                glfwPostEmptyEvent();
+
             int numScreens = 0;
+            bool drawing = false;
+            double wake = -1;
             for (auto kv : __nanogui_screens) {
                 Screen *screen = kv.second;
                 if (!screen->visible()) {
@@ -78,9 +151,23 @@ void mainloop() {
                     screen->setVisible(false);
                     continue;
                 }
-                screen->drawAll();
                 numScreens++;
+
+                /* Iconified and throttled screens keep up with input and
+                   posted tasks, but draw later (or not at all) */
+                screen->runPending();
+                double delay = screen->frameDelay();
+                if (delay == 0) {
+                    screen->drawAll();
+                    drawing = true;
+                } else if (delay > 0) {
+                    double due = glfwGetTime() + delay;
+                    if (wake < 0 || due < wake)
+                        wake = due;
+                }
             }
+            __wake_time = wake;
+            __screens_drawing = drawing;
 
             if (numScreens == 0) {
                 /* Give up if there was nothing to draw */
@@ -88,6 +175,18 @@ void mainloop() {
                 break;
             }
 
+            /* Run what was waiting for this frame; anything queued in the
+               meantime waits for the next one */
+            std::vector<TaskQueue::Task> frameTasks;
+            TaskQueue::Task task;
+            while (__nanogui_frame_tasks.pop(task))
+                frameTasks.push_back(std::move(task));
+            if (!frameTasks.empty()) {
+                auto locks = lock_screens_helper();
+                for (auto &frameTask : frameTasks)
+                    frameTask();
+            }
+
             /* Wait for mouse/keyboard or empty refresh events */
             glfwWaitEvents();
         }
@@ -103,6 +202,33 @@ void leave() {
     __mainloop_active = false;
 }
 
+void post(std::function<void()> task) {
+    __nanogui_tasks.push(std::move(task));
+    glfwPostEmptyEvent();
+}
+
+void setPowerPolicy(PowerPolicy policy) {
+    __power_policy = (int) policy;
+    glfwPostEmptyEvent();
+}
+
+PowerPolicy powerPolicy() {
+    return (PowerPolicy) __power_policy.load();
+}
+
+void postAfterFrame(std::function<void()> task) {
+    __nanogui_frame_tasks.push(std::move(task));
+    glfwPostEmptyEvent();
+}
+
+void postDelayed(std::function<void()> task, double delay) {
+    auto due = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(delay));
+    std::lock_guard<std::mutex> guard(__nanogui_timer_mutex);
+    __nanogui_timers.emplace(due, std::move(task));
+}
+
 void shutdown() {
     glfwTerminate();
 }
@@ -129,14 +255,47 @@ std::array<char, 8> utf8(int c) {
 }
 
 int __nanogui_get_image(NVGcontext *ctx, const std::string &name, uint8_t *data, uint32_t size) {
-    static std::map<std::string, int> iconCache;
-    auto it = iconCache.find(name);
+    /* Images too large for the atlas get a texture of their own */
+    static std::map<std::pair<NVGcontext *, std::string>, int> iconCache;
+
+    /* Widgets measured during parallel layout get a measurement context,
+       which cannot create images; only icons that the main context already
+       loaded are visible there (read-only, the main thread measures too) */
+    NVGcontext *main = LayoutPool::mainContext(ctx);
+    if (main != ctx) {
+        ImageAtlas *atlas = ImageAtlas::find(main);
+        int iconID = atlas ? atlas->lookup(name) : 0;
+        if (iconID != 0)
+            return iconID;
+        auto it = iconCache.find(std::make_pair(main, name));
+        if (it != iconCache.end())
+            return it->second;
+        throw std::runtime_error("Images cannot be created during parallel layout, "
+                                 "load \"" + name + "\" beforehand.");
+    }
+
+    auto key = std::make_pair(ctx, name);
+    auto it = iconCache.find(key);
     if (it != iconCache.end())
         return it->second;
-    int iconID = nvgCreateImageMem(ctx, 0, data, size);
+
+    /* Small icons share atlas textures so that NanoVG can batch them */
+    int iconID = ImageAtlas::get(ctx).add(name, data, size);
+    if (iconID != 0)
+        return iconID;
+
+    /* Contexts sharing resources with another one refer to its texture */
+    NVGcontext *owner = ImageAtlas::owner(ctx);
+    if (owner != ctx) {
+        iconID = nvgShareImage(ctx, owner, __nanogui_get_image(owner, name, data, size));
+        iconCache[key] = iconID;
+        return iconID;
+    }
+
+    iconID = nvgCreateImageMem(ctx, 0, data, size);
     if (iconID == 0)
         throw std::runtime_error("Unable to load resource data.");
-    iconCache[name] = iconID;
+    iconCache[key] = iconID;
     return iconID;
 }
 
@@ -13,35 +13,53 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <map>
+#include <algorithm>
 
 namespace nanogui {
 
-static GLuint createShader_helper(GLint type, const std::string &name,
-                                  const std::string &defines,
-                                  std::string shader_string) {
-    if (shader_string.empty())
-        return (GLuint) 0;
+static std::string preprocess_helper(const std::string &defines,
+                                     const std::string &shader_string) {
+    if (defines.empty())
+        return shader_string;
 
-    if (!defines.empty()) {
-        if (shader_string.length() > 8 && shader_string.substr(0, 8) == "#version") {
-            std::istringstream iss(shader_string);
-            std::ostringstream oss;
-            std::string line;
-            std::getline(iss, line);
+    if (shader_string.length() > 8 && shader_string.substr(0, 8) == "#version") {
+        std::istringstream iss(shader_string);
+        std::ostringstream oss;
+        std::string line;
+        std::getline(iss, line);
+        oss << line << std::endl;
+        oss << defines;
+        while (std::getline(iss, line))
             oss << line << std::endl;
-            oss << defines;
-            while (std::getline(iss, line))
-                oss << line << std::endl;
-            shader_string = oss.str();
-        } else {
-            shader_string = defines + shader_string;
-        }
+        return oss.str();
+    } else {
+        return defines + shader_string;
     }
+}
+
+/* Submit a shader for compilation without waiting for the result */
+static GLuint compileShader_helper(GLint type, const std::string &defines,
+                                   const std::string &shader_string) {
+    if (shader_string.empty())
+        return (GLuint) 0;
 
+    std::string source = preprocess_helper(defines, shader_string);
     GLuint id = glCreateShader(type);
-    const char *shader_string_const = shader_string.c_str();
+    const char *shader_string_const = source.c_str();
     glShaderSource(id, 1, &shader_string_const, nullptr);
     glCompileShader(id);
+    return id;
+}
+
+static void checkShader_helper(GLuint id, GLint type, const std::string &name,
+                               const std::string &defines,
+                               const std::string &shader_string) {
+    if (!id)
+        return;
 
     GLint status;
     glGetShaderiv(id, GL_COMPILE_STATUS, &status);
@@ -56,15 +74,200 @@ static GLuint createShader_helper(GLint type, const std::string &name,
         else if (type == GL_GEOMETRY_SHADER)
             std::cerr << "geometry shader";
         std::cerr << " \"" << name << "\":" << std::endl;
-        std::cerr << shader_string << std::endl << std::endl;
+        std::cerr << preprocess_helper(defines, shader_string) << std::endl << std::endl;
         glGetShaderInfoLog(id, 512, nullptr, buffer);
         std::cerr << "Error: " << std::endl << buffer << std::endl;
         throw std::runtime_error("Shader compilation failed!");
     }
+}
 
+static GLuint createShader_helper(GLint type, const std::string &name,
+                                  const std::string &defines,
+                                  const std::string &shader_string) {
+    GLuint id = compileShader_helper(type, defines, shader_string);
+    checkShader_helper(id, type, name, defines, shader_string);
     return id;
 }
 
+/* Program binaries (GL 4.1 / ARB_get_program_binary) are not part of the
+   GL 3.3 core profile exposed by glad, so the entry points are resolved
+   through GLFW on first use */
+#define NANOGUI_GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define NANOGUI_GL_PROGRAM_BINARY_LENGTH           0x8741
+#define NANOGUI_GL_NUM_PROGRAM_BINARY_FORMATS      0x87FE
+
+typedef void (APIENTRYP PFNNANOGUIGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNNANOGUIPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNNANOGUIPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+struct ProgramBinaryAPI {
+    PFNNANOGUIGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+    PFNNANOGUIPROGRAMBINARYPROC programBinary = nullptr;
+    PFNNANOGUIPROGRAMPARAMETERIPROC programParameteri = nullptr;
+};
+
+/* Resolved per context, since function pointers and extension support may differ */
+static std::map<GLFWwindow *, ProgramBinaryAPI> __nanogui_program_apis;
+
+static const ProgramBinaryAPI &programBinaryAPI() {
+    GLFWwindow *context = glfwGetCurrentContext();
+    auto it = __nanogui_program_apis.find(context);
+    if (it != __nanogui_program_apis.end())
+        return it->second;
+
+    ProgramBinaryAPI api;
+    GLint major = 0, minor = 0, formats = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 1) ||
+        glfwExtensionSupported("GL_ARB_get_program_binary")) {
+        glGetIntegerv(NANOGUI_GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats > 0) {
+            api.getProgramBinary = (PFNNANOGUIGETPROGRAMBINARYPROC) glfwGetProcAddress("glGetProgramBinary");
+            api.programBinary = (PFNNANOGUIPROGRAMBINARYPROC) glfwGetProcAddress("glProgramBinary");
+            api.programParameteri = (PFNNANOGUIPROGRAMPARAMETERIPROC) glfwGetProcAddress("glProgramParameteri");
+            if (!api.getProgramBinary || !api.programBinary || !api.programParameteri)
+                api = ProgramBinaryAPI();
+        }
+    }
+    return __nanogui_program_apis[context] = api;
+}
+
+/* Linked programs shared between GLShader instances with identical sources
+   that opted in via GLShader::setShareProgram() */
+struct SharedProgram {
+    GLuint program;
+    int refCount;
+};
+
+static std::map<std::pair<GLFWwindow *, uint64_t>, SharedProgram> __nanogui_programs;
+static std::string __nanogui_shader_cache_dir;
+
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint8_t) data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    /* Separator, so that ("ab", "c") and ("a", "bc") hash differently */
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t fnv1a(uint64_t hash, const std::string &str) {
+    return fnv1a(hash, str.data(), str.size());
+}
+
+static uint64_t fnv1a(uint64_t hash, GLenum name) {
+    const char *str = (const char *) glGetString(name);
+    return fnv1a(hash, str ? str : "", str ? strlen(str) : 0);
+}
+
+static std::string programCachePath(uint64_t key) {
+    if (__nanogui_shader_cache_dir.empty())
+        return "";
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) key);
+    std::string path = __nanogui_shader_cache_dir;
+    if (path.back() != '/' && path.back() != '\\')
+        path += '/';
+    return path + hex + ".bin";
+}
+
+/* Cache file layout: magic, binary format, length, driver-specific blob */
+static const uint32_t __nanogui_program_magic = 0x42505456; /* "VTPB" */
+
+static GLuint loadProgramBinary(uint64_t key) {
+    const ProgramBinaryAPI &api = programBinaryAPI();
+    std::string path = programCachePath(key);
+    if (!api.programBinary || path.empty())
+        return 0;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return 0;
+
+    uint32_t header[3];
+    if (!in.read((char *) header, sizeof(header)) ||
+        header[0] != __nanogui_program_magic || header[2] == 0)
+        return 0;
+
+    std::vector<char> binary(header[2]);
+    if (!in.read(binary.data(), binary.size()))
+        return 0;
+
+    GLuint program = glCreateProgram();
+    api.programBinary(program, (GLenum) header[1], binary.data(), (GLsizei) binary.size());
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        /* Typically a driver update: drop the stale entry and recompile */
+        glDeleteProgram(program);
+        in.close();
+        std::remove(path.c_str());
+        return 0;
+    }
+    return program;
+}
+
+static void storeProgramBinary(uint64_t key, GLuint program) {
+    const ProgramBinaryAPI &api = programBinaryAPI();
+    std::string path = programCachePath(key);
+    if (!api.getProgramBinary || path.empty())
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, NANOGUI_GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary((size_t) length);
+    GLenum format = 0;
+    api.getProgramBinary(program, length, &length, &format, binary.data());
+
+    /* Write to a temporary file first so that a crash never leaves a truncated entry */
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return;
+        uint32_t header[3] = { __nanogui_program_magic, (uint32_t) format, (uint32_t) length };
+        out.write((const char *) header, sizeof(header));
+        out.write(binary.data(), length);
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    std::remove(path.c_str());
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+static uint64_t programKey_helper(const std::string &defines,
+                                  const std::string &vertex_str,
+                                  const std::string &fragment_str,
+                                  const std::string &geometry_str) {
+    uint64_t key = 0xcbf29ce484222325ULL;
+    key = fnv1a(key, GL_VENDOR);
+    key = fnv1a(key, GL_RENDERER);
+    key = fnv1a(key, GL_VERSION);
+    key = fnv1a(key, defines);
+    key = fnv1a(key, vertex_str);
+    key = fnv1a(key, fragment_str);
+    key = fnv1a(key, geometry_str);
+    return key;
+}
+
+void GLShader::setCacheDirectory(const std::string &path) {
+    __nanogui_shader_cache_dir = path;
+}
+
+const std::string &GLShader::cacheDirectory() {
+    return __nanogui_shader_cache_dir;
+}
+
 bool GLShader::initFromFiles(
     const std::string &name,
     const std::string &vertex_fname,
@@ -88,12 +291,12 @@ bool GLShader::init(const std::string &name,
                     const std::string &vertex_str,
                     const std::string &fragment_str,
                     const std::string &geometry_str) {
-    std::string defines;
-    for (auto def : mDefinitions)
-        defines += std::string("#define ") + def.first + std::string(" ") + def.second + "\n";
+    std::string defines = prepare(name);
+    uint64_t key = programKey_helper(defines, vertex_str, fragment_str, geometry_str);
+
+    if (acquireProgram(key))
+        return true;
 
-    glGenVertexArrays(1, &mVertexArrayObject);
-    mName = name;
     mVertexShader =
         createShader_helper(GL_VERTEX_SHADER, name, defines, vertex_str);
     mGeometryShader =
@@ -106,6 +309,291 @@ bool GLShader::init(const std::string &name,
     if (!geometry_str.empty() && !mGeometryShader)
         return false;
 
+    linkProgram();
+    finishProgram(key);
+
+    return true;
+}
+
+/* Asynchronous initializations still in flight. Only weak references are
+   kept: a state whose shader was destroyed or reassigned simply expires. */
+static std::vector<std::weak_ptr<GLShader::AsyncInit>> __nanogui_pending_shaders;
+
+#define NANOGUI_GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNNANOGUIMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static std::map<GLFWwindow *, bool> __nanogui_parallel_compile;
+
+/* Returns true if the driver compiles shaders on background threads */
+static bool parallelCompileSupported() {
+    GLFWwindow *context = glfwGetCurrentContext();
+    auto it = __nanogui_parallel_compile.find(context);
+    if (it != __nanogui_parallel_compile.end())
+        return it->second;
+
+    bool khr = glfwExtensionSupported("GL_KHR_parallel_shader_compile") != 0;
+    bool arb = glfwExtensionSupported("GL_ARB_parallel_shader_compile") != 0;
+    auto maxThreads = (PFNNANOGUIMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress(
+        khr ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB");
+    if ((khr || arb) && maxThreads)
+        maxThreads(0xFFFFFFFFu); /* Let the driver pick the number of threads */
+    return __nanogui_parallel_compile[context] = khr || arb;
+}
+
+struct GLShader::AsyncInit {
+    enum Stage { CompileVertex, CompileGeometry, CompileFragment, Link,
+                 WaitCompile, WaitLink };
+
+    std::string defines, vertex, fragment, geometry;
+    uint64_t key;
+    GLFWwindow *context;
+    GLShader *shader; /* Owner, cleared once it stops advancing this state */
+    bool parallel;
+    Stage stage;
+    std::function<void(bool)> callback;
+};
+
+bool GLShader::initAsync(const std::string &name,
+                         const std::string &vertex_str,
+                         const std::string &fragment_str,
+                         const std::string &geometry_str,
+                         const std::function<void(bool)> &callback) {
+    std::string defines = prepare(name);
+    uint64_t key = programKey_helper(defines, vertex_str, fragment_str, geometry_str);
+
+    if (acquireProgram(key)) {
+        if (callback)
+            callback(true);
+        return true;
+    }
+
+    mAsync = std::make_shared<AsyncInit>();
+    mAsync->defines = defines;
+    mAsync->vertex = vertex_str;
+    mAsync->fragment = fragment_str;
+    mAsync->geometry = geometry_str;
+    mAsync->key = key;
+    mAsync->context = glfwGetCurrentContext();
+    mAsync->parallel = parallelCompileSupported();
+    mAsync->callback = callback;
+    mAsync->stage = AsyncInit::CompileVertex;
+    mAsync->shader = this;
+    __nanogui_pending_shaders.push_back(mAsync);
+
+    /* With parallel compilation, submitting everything up front is cheap */
+    if (mAsync->parallel)
+        ready();
+
+    return false;
+}
+
+bool GLShader::initAsyncFromFiles(const std::string &name,
+                                  const std::string &vertex_fname,
+                                  const std::string &fragment_fname,
+                                  const std::string &geometry_fname,
+                                  const std::function<void(bool)> &callback) {
+    auto file_to_string = [](const std::string &filename) -> std::string {
+        if (filename.empty())
+            return "";
+        std::ifstream t(filename);
+        return std::string((std::istreambuf_iterator<char>(t)),
+                           std::istreambuf_iterator<char>());
+    };
+
+    return initAsync(name,
+                     file_to_string(vertex_fname),
+                     file_to_string(fragment_fname),
+                     file_to_string(geometry_fname),
+                     callback);
+}
+
+bool GLShader::ready() {
+    if (!mAsync)
+        return mProgramShader != 0;
+    if (mAsync->context != glfwGetCurrentContext())
+        return false;
+
+    bool done = false, success = false;
+    try {
+        done = success = advanceAsync();
+    } catch (const std::exception &e) {
+        std::cerr << "Asynchronous initialization of shader \"" << mName
+                  << "\" failed: " << e.what() << std::endl;
+        done = true;
+    }
+    if (!done)
+        return false;
+
+    std::shared_ptr<AsyncInit> async = mAsync;
+    cancelAsync();
+    if (!success) {
+        if (mProgramShader)
+            glDeleteProgram(mProgramShader);
+        mProgramShader = 0;
+        glDeleteShader(mVertexShader);   mVertexShader = 0;
+        glDeleteShader(mFragmentShader); mFragmentShader = 0;
+        glDeleteShader(mGeometryShader); mGeometryShader = 0;
+    }
+    if (async->callback)
+        async->callback(success);
+    return success;
+}
+
+bool GLShader::advanceAsync() {
+    AsyncInit &a = *mAsync;
+
+    if (a.parallel) {
+        switch (a.stage) {
+            case AsyncInit::WaitCompile: {
+                for (GLuint id : { mVertexShader, mGeometryShader, mFragmentShader }) {
+                    GLint completed = GL_TRUE;
+                    if (id)
+                        glGetShaderiv(id, NANOGUI_GL_COMPLETION_STATUS_KHR, &completed);
+                    if (!completed)
+                        return false;
+                }
+                checkShader_helper(mVertexShader, GL_VERTEX_SHADER, mName, a.defines, a.vertex);
+                checkShader_helper(mGeometryShader, GL_GEOMETRY_SHADER, mName, a.defines, a.geometry);
+                checkShader_helper(mFragmentShader, GL_FRAGMENT_SHADER, mName, a.defines, a.fragment);
+                if (!mVertexShader || !mFragmentShader)
+                    throw std::runtime_error("Missing vertex or fragment shader!");
+                linkProgram();
+                a.stage = AsyncInit::WaitLink;
+                return false;
+            }
+
+            case AsyncInit::WaitLink: {
+                GLint completed = GL_TRUE;
+                glGetProgramiv(mProgramShader, NANOGUI_GL_COMPLETION_STATUS_KHR, &completed);
+                if (!completed)
+                    return false;
+                finishProgram(a.key);
+                return true;
+            }
+
+            default:
+                mVertexShader = compileShader_helper(GL_VERTEX_SHADER, a.defines, a.vertex);
+                mGeometryShader = compileShader_helper(GL_GEOMETRY_SHADER, a.defines, a.geometry);
+                mFragmentShader = compileShader_helper(GL_FRAGMENT_SHADER, a.defines, a.fragment);
+                a.stage = AsyncInit::WaitCompile;
+                return false;
+        }
+    }
+
+    /* No driver support: do one blocking step per call to spread the cost over frames */
+    switch (a.stage) {
+        case AsyncInit::CompileVertex:
+            mVertexShader = createShader_helper(GL_VERTEX_SHADER, mName, a.defines, a.vertex);
+            a.stage = a.geometry.empty() ? AsyncInit::CompileFragment : AsyncInit::CompileGeometry;
+            return false;
+
+        case AsyncInit::CompileGeometry:
+            mGeometryShader = createShader_helper(GL_GEOMETRY_SHADER, mName, a.defines, a.geometry);
+            a.stage = AsyncInit::CompileFragment;
+            return false;
+
+        case AsyncInit::CompileFragment:
+            mFragmentShader = createShader_helper(GL_FRAGMENT_SHADER, mName, a.defines, a.fragment);
+            a.stage = AsyncInit::Link;
+            return false;
+
+        default:
+            if (!mVertexShader || !mFragmentShader)
+                throw std::runtime_error("Missing vertex or fragment shader!");
+            linkProgram();
+            finishProgram(a.key);
+            return true;
+    }
+}
+
+void GLShader::cancelAsync() {
+    if (mAsync && mAsync->shader == this)
+        mAsync->shader = nullptr;
+    mAsync.reset();
+    __nanogui_pending_shaders.erase(
+        std::remove_if(__nanogui_pending_shaders.begin(), __nanogui_pending_shaders.end(),
+            [](const std::weak_ptr<AsyncInit> &entry) {
+                std::shared_ptr<AsyncInit> async = entry.lock();
+                return !async || !async->shader;
+            }),
+        __nanogui_pending_shaders.end());
+}
+
+void GLShader::release(GLFWwindow *context) {
+    for (auto it = __nanogui_programs.begin(); it != __nanogui_programs.end(); ) {
+        if (it->first.first == context)
+            it = __nanogui_programs.erase(it);
+        else
+            ++it;
+    }
+    __nanogui_program_apis.erase(context);
+    __nanogui_parallel_compile.erase(context);
+
+    std::vector<std::weak_ptr<AsyncInit>> pending = __nanogui_pending_shaders;
+    for (auto &entry : pending) {
+        std::shared_ptr<AsyncInit> async = entry.lock();
+        if (async && async->shader && async->context == context)
+            async->shader->cancelAsync();
+    }
+}
+
+void GLShader::processPending() {
+    /* Callbacks may create or free shaders, so iterate over a snapshot */
+    std::vector<std::weak_ptr<AsyncInit>> pending = __nanogui_pending_shaders;
+    for (auto &entry : pending) {
+        std::shared_ptr<AsyncInit> async = entry.lock();
+        if (async && async->shader && async->shader->mAsync == async)
+            async->shader->ready();
+    }
+}
+
+GLShader::~GLShader() {
+    if (mAsync)
+        cancelAsync();
+}
+
+std::string GLShader::prepare(const std::string &name) {
+    std::string defines;
+    for (auto def : mDefinitions)
+        defines += std::string("#define ") + def.first + std::string(" ") + def.second + "\n";
+
+    glGenVertexArrays(1, &mVertexArrayObject);
+    mName = name;
+    return defines;
+}
+
+bool GLShader::acquireProgram(uint64_t key) {
+    /* An identical program was already linked in this context */
+    if (mShareProgram) {
+        auto it = __nanogui_programs.find(std::make_pair(glfwGetCurrentContext(), key));
+        if (it != __nanogui_programs.end()) {
+            it->second.refCount++;
+            mProgramShader = it->second.program;
+            mProgramKey = key;
+            reflect();
+            return true;
+        }
+    }
+
+    /* Otherwise try the on-disk cache before invoking the compiler */
+    if ((mProgramShader = loadProgramBinary(key)) != 0) {
+        registerProgram(key);
+        reflect();
+        return true;
+    }
+
+    return false;
+}
+
+void GLShader::registerProgram(uint64_t key) {
+    if (!mShareProgram)
+        return;
+    __nanogui_programs[std::make_pair(glfwGetCurrentContext(), key)] =
+        SharedProgram { mProgramShader, 1 };
+    mProgramKey = key;
+}
+
+void GLShader::linkProgram() {
     mProgramShader = glCreateProgram();
 
     glAttachShader(mProgramShader, mVertexShader);
@@ -114,8 +602,14 @@ bool GLShader::init(const std::string &name,
     if (mGeometryShader)
         glAttachShader(mProgramShader, mGeometryShader);
 
+    const ProgramBinaryAPI &api = programBinaryAPI();
+    if (api.programParameteri && !__nanogui_shader_cache_dir.empty())
+        api.programParameteri(mProgramShader, NANOGUI_GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     glLinkProgram(mProgramShader);
+}
 
+void GLShader::finishProgram(uint64_t key) {
     GLint status;
     glGetProgramiv(mProgramShader, GL_LINK_STATUS, &status);
 
@@ -123,11 +617,103 @@ bool GLShader::init(const std::string &name,
         char buffer[512];
         glGetProgramInfoLog(mProgramShader, 512, nullptr, buffer);
         std::cerr << "Linker error (" << mName << "): " << std::endl << buffer << std::endl;
+        glDeleteProgram(mProgramShader);
         mProgramShader = 0;
         throw std::runtime_error("Shader linking failed!");
     }
 
-    return true;
+    storeProgramBinary(key, mProgramShader);
+    registerProgram(key);
+
+    reflect();
+}
+
+void GLShader::reflect() {
+    mUniforms.clear();
+    mAttribs.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer((size_t) std::max(maxLength, 1));
+
+    glGetProgramiv(mProgramShader, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        Variable var;
+        glGetActiveUniform(mProgramShader, (GLuint) i, (GLsizei) buffer.size(),
+                           &length, &var.size, &var.type, buffer.data());
+        var.name = std::string(buffer.data(), (size_t) length);
+
+        var.location = glGetUniformLocation(mProgramShader, var.name.c_str());
+        if (var.location < 0)
+            continue; /* Member of a uniform block */
+        mUniforms.push_back(var);
+
+        /* Arrays of basic types are reported as "name[0]": also register the
+           bare name and every element. Struct members such as "s[0].x" are
+           reported individually and only need their full name. */
+        const std::string suffix = "[0]";
+        if (var.name.size() <= suffix.size() ||
+            var.name.compare(var.name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            continue;
+        std::string base = var.name.substr(0, var.name.size() - suffix.size());
+
+        Variable bare = var;
+        bare.name = base;
+        mUniforms.push_back(bare);
+
+        for (GLint j = 1; j < var.size; ++j) {
+            Variable element = var;
+            element.name = base + "[" + std::to_string(j) + "]";
+            element.location = glGetUniformLocation(mProgramShader, element.name.c_str());
+            element.size = 1;
+            if (element.location >= 0)
+                mUniforms.push_back(element);
+        }
+    }
+
+    glGetProgramiv(mProgramShader, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    buffer.resize((size_t) std::max(maxLength, 1));
+
+    glGetProgramiv(mProgramShader, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        Variable var;
+        glGetActiveAttrib(mProgramShader, (GLuint) i, (GLsizei) buffer.size(),
+                          &length, &var.size, &var.type, buffer.data());
+        var.name = std::string(buffer.data(), (size_t) length);
+        var.location = glGetAttribLocation(mProgramShader, var.name.c_str());
+        if (var.location < 0)
+            continue; /* Built-in such as gl_VertexID */
+        mAttribs.push_back(var);
+    }
+
+    auto byName = [](const Variable &a, const Variable &b) { return a.name < b.name; };
+    std::sort(mUniforms.begin(), mUniforms.end(), byName);
+    std::sort(mAttribs.begin(), mAttribs.end(), byName);
+}
+
+const GLShader::Variable *GLShader::findVariable(const std::vector<Variable> &table,
+                                                 const std::string &name) {
+    auto it = std::lower_bound(table.begin(), table.end(), name,
+        [](const Variable &var, const std::string &name) { return var.name < name; });
+    if (it == table.end() || it->name != name)
+        return nullptr;
+    return &*it;
+}
+
+GLShader::Buffer *GLShader::findBuffer(const std::string &name) {
+    for (auto &buf : mBufferObjects)
+        if (buf.name == name)
+            return &buf;
+    return nullptr;
+}
+
+const GLShader::Buffer *GLShader::findBuffer(const std::string &name) const {
+    for (auto const &buf : mBufferObjects)
+        if (buf.name == name)
+            return &buf;
+    return nullptr;
 }
 
 void GLShader::bind() {
@@ -136,71 +722,265 @@ void GLShader::bind() {
 }
 
 GLint GLShader::attrib(const std::string &name, bool warn) const {
-    GLint id = glGetAttribLocation(mProgramShader, name.c_str());
+    const Variable *var = findVariable(mAttribs, name);
+    GLint id = var ? var->location : -1;
     if (id == -1 && warn)
         std::cerr << mName << ": warning: did not find attrib " << name << std::endl;
     return id;
 }
 
 GLint GLShader::uniform(const std::string &name, bool warn) const {
-    GLint id = glGetUniformLocation(mProgramShader, name.c_str());
+    const Variable *var = findVariable(mUniforms, name);
+    GLint id = var ? var->location : -1;
     if (id == -1 && warn)
         std::cerr << mName << ": warning: did not find uniform " << name << std::endl;
     return id;
 }
 
+GLShader::Buffer *GLShader::createBuffer(const std::string &name, GLint attribID) {
+    Buffer buffer;
+    glGenBuffers(1, &buffer.id);
+    buffer.name = name;
+    buffer.attribID = attribID;
+    buffer.glType = GL_FLOAT;
+    buffer.dim = 0;
+    buffer.compSize = 0;
+    buffer.size = 0;
+    buffer.version = -1;
+    buffer.mode = BufferUpdate::Static;
+    buffer.capacity = 0;
+    buffer.offset = 0;
+    buffer.segment = 0;
+    buffer.integral = false;
+    buffer.divisor = 0;
+    for (int i = 0; i < StreamSegments; ++i)
+        buffer.fences[i] = nullptr;
+    mBufferObjects.push_back(buffer);
+    return &mBufferObjects.back();
+}
+
+void GLShader::releaseBuffer(Buffer &buffer) {
+    for (int i = 0; i < StreamSegments; ++i) {
+        if (buffer.fences[i]) {
+            glDeleteSync(buffer.fences[i]);
+            buffer.fences[i] = nullptr;
+        }
+    }
+    glDeleteBuffers(1, &buffer.id);
+    buffer.id = 0;
+}
+
+void GLShader::setAttribUpdateMode(const std::string &name, BufferUpdate mode) {
+    Buffer *buf = findBuffer(name);
+    if (!buf) {
+        /* Remember the mode for the first upload; type info is filled in then.
+           Names that are not attributes may refer to an interleaved buffer. */
+        buf = createBuffer(name, name == "indices" ? 0 : attrib(name, false));
+    }
+    if (buf->mode == mode)
+        return;
+    for (int i = 0; i < StreamSegments; ++i) {
+        if (buf->fences[i]) {
+            glDeleteSync(buf->fences[i]);
+            buf->fences[i] = nullptr;
+        }
+    }
+    /* Force a reallocation with the new layout on the next upload */
+    buf->mode = mode;
+    buf->capacity = 0;
+    buf->offset = 0;
+    buf->segment = 0;
+    buf->version = -1;
+}
+
 void GLShader::uploadAttrib(const std::string &name, uint32_t size, int dim,
                              uint32_t compSize, GLuint glType, bool integral, const uint8_t *data, int version) {
-    int attribID = 0;
-    if (name != "indices") {
-        attribID = attrib(name);
+    Buffer *buf = findBuffer(name);
+    if (!buf || buf->attribID < 0) {
+        GLint attribID = name == "indices" ? 0 : attrib(name);
         if (attribID < 0)
             return;
+        if (!buf)
+            buf = createBuffer(name, attribID);
+        buf->attribID = attribID;
+    } else if (version != -1 && buf->version == version && buf->size == size &&
+               buf->dim == (GLuint) dim && buf->compSize == compSize) {
+        return; /* Data is unchanged since the last upload */
     }
 
-    GLuint bufferID;
-    auto it = mBufferObjects.find(name);
-    if (it != mBufferObjects.end()) {
-        Buffer &buffer = it->second;
-        bufferID = it->second.id;
-        buffer.version = version;
-        buffer.size = size;
-        buffer.compSize = compSize;
-    } else {
-        glGenBuffers(1, &bufferID);
-        Buffer buffer;
-        buffer.id = bufferID;
-        buffer.glType = glType;
-        buffer.dim = dim;
-        buffer.compSize = compSize;
-        buffer.size = size;
-        buffer.version = version;
-        mBufferObjects[name] = buffer;
+    buf->glType = glType;
+    buf->dim = dim;
+    buf->compSize = compSize;
+    buf->size = size;
+    buf->version = version;
+    buf->integral = integral;
+
+    GLenum target = name == "indices" ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    writeBuffer(*buf, target, data, (size_t) size * (size_t) compSize);
+
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+        mIndexOffset = buf->offset;
+    else
+        bindAttribPointers(*buf);
+}
+
+void GLShader::uploadInterleaved(const std::string &name, const VertexLayout &layout,
+                                 const void *data, uint32_t count, int version) {
+    if (layout.attributes().empty() || layout.stride() == 0)
+        throw std::runtime_error(mName + ": uploadInterleaved: empty vertex layout!");
+
+    uint32_t size = count * (uint32_t) layout.stride();
+    Buffer *buf = findBuffer(name);
+    if (!buf) {
+        buf = createBuffer(name, -1);
+    } else if (version != -1 && buf->version == version && buf->size == size &&
+               buf->layout == layout) {
+        return; /* Data and layout are unchanged since the last upload */
     }
-    size_t totalSize = (size_t) size * (size_t) compSize;
 
-    if (name == "indices") {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
-    } else {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-        glBufferData(GL_ARRAY_BUFFER, totalSize, data, GL_DYNAMIC_DRAW);
-        if (size == 0) {
-            glDisableVertexAttribArray(attribID);
+    buf->glType = GL_UNSIGNED_BYTE;
+    buf->dim = (GLuint) layout.stride();
+    buf->compSize = 1;
+    buf->size = size;
+    buf->version = version;
+    buf->integral = false;
+    buf->layout = layout;
+    buf->divisor = layout.divisor();
+
+    writeBuffer(*buf, GL_ARRAY_BUFFER, (const uint8_t *) data, size);
+    bindAttribPointers(*buf);
+}
+
+void GLShader::writeBuffer(Buffer &buf, GLenum target, const uint8_t *data, size_t totalSize) {
+    glBindBuffer(target, buf.id);
+
+    switch (buf.mode) {
+        case BufferUpdate::Static:
+            if (totalSize > 0 && totalSize <= buf.capacity) {
+                glBufferSubData(target, 0, totalSize, data);
+            } else {
+                glBufferData(target, totalSize, data, GL_DYNAMIC_DRAW);
+                buf.capacity = totalSize;
+            }
+            buf.offset = 0;
+            break;
+
+        case BufferUpdate::Orphan:
+            /* Hand the old storage back to the driver instead of waiting for it */
+            if (totalSize > buf.capacity) {
+                glBufferData(target, totalSize, data, GL_STREAM_DRAW);
+                buf.capacity = totalSize;
+            } else if (totalSize > 0) {
+                glBufferData(target, buf.capacity, nullptr, GL_STREAM_DRAW);
+                glBufferSubData(target, 0, totalSize, data);
+            }
+            buf.offset = 0;
+            break;
+
+        case BufferUpdate::Stream:
+            if (totalSize > buf.capacity) {
+                for (int i = 0; i < StreamSegments; ++i) {
+                    if (buf.fences[i]) {
+                        glDeleteSync(buf.fences[i]);
+                        buf.fences[i] = nullptr;
+                    }
+                }
+                /* Leave some headroom so that slowly growing data does not reallocate every frame */
+                buf.capacity = std::max(totalSize + totalSize / 2, (size_t) 256);
+                glBufferData(target, buf.capacity * StreamSegments, nullptr, GL_STREAM_DRAW);
+                buf.segment = 0;
+            } else {
+                /* Draws issued so far read the current segment: fence it and move on */
+                buf.fences[buf.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                buf.segment = (buf.segment + 1) % StreamSegments;
+                GLsync fence = buf.fences[buf.segment];
+                if (fence) {
+                    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                        ;
+                    glDeleteSync(fence);
+                    buf.fences[buf.segment] = nullptr;
+                }
+            }
+            buf.offset = (size_t) buf.segment * buf.capacity;
+            if (totalSize > 0) {
+                void *ptr = glMapBufferRange(target, buf.offset, totalSize,
+                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+                if (!ptr)
+                    throw std::runtime_error(mName + ": could not map buffer \"" + buf.name + "\"!");
+                memcpy(ptr, data, totalSize);
+                glUnmapBuffer(target);
+            }
+            break;
+    }
+}
+
+void GLShader::bindAttribPointers(const Buffer &buf) {
+    glBindBuffer(GL_ARRAY_BUFFER, buf.id);
+
+    if (buf.layout.attributes().empty()) {
+        if (buf.size == 0) {
+            glDisableVertexAttribArray(buf.attribID);
         } else {
-            glEnableVertexAttribArray(attribID);
-            glVertexAttribPointer(attribID, dim, glType, integral, 0, 0);
+            glEnableVertexAttribArray(buf.attribID);
+            glVertexAttribPointer(buf.attribID, buf.dim, buf.glType, buf.integral, 0,
+                                  (const void *) buf.offset);
+            glVertexAttribDivisor(buf.attribID, buf.divisor);
         }
+        return;
     }
+
+    for (auto const &a : buf.layout.attributes()) {
+        GLint id = attrib(a.name, false);
+        if (id < 0)
+            continue;
+        if (buf.size == 0) {
+            glDisableVertexAttribArray(id);
+            continue;
+        }
+        glEnableVertexAttribArray(id);
+        glVertexAttribPointer(id, a.dim, a.glType, a.normalized, (GLsizei) buf.layout.stride(),
+                              (const void *) (buf.offset + a.offset));
+        glVertexAttribDivisor(id, buf.divisor);
+    }
+}
+
+void GLShader::setAttribDivisor(const std::string &name, uint32_t divisor) {
+    Buffer *buf = findBuffer(name);
+    if (!buf)
+        throw std::runtime_error("setAttribDivisor(" + mName + ", " + name + ") : buffer not found!");
+    buf->divisor = divisor;
+    if (buf->size > 0)
+        bindAttribPointers(*buf);
+}
+
+void GLShader::updateAttrib(const std::string &name, uint32_t offset, uint32_t size,
+                            int dim, uint32_t compSize, const uint8_t *data) {
+    Buffer *buf = findBuffer(name);
+    if (!buf)
+        throw std::runtime_error("updateAttrib(" + mName + ", " + name + ") : buffer not found!");
+    if (buf->mode == BufferUpdate::Stream)
+        throw std::runtime_error(mName + ": updateAttrib: partial updates of streamed buffers are not supported!");
+    if (buf->compSize != compSize || buf->dim != (GLuint) dim)
+        throw std::runtime_error(mName + ": updateAttrib: layout mismatch!");
+    if ((size_t) offset * dim + size > buf->size)
+        throw std::runtime_error(mName + ": updateAttrib: range exceeds buffer size!");
+    if (size == 0)
+        return;
+
+    GLenum target = name == "indices" ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    glBindBuffer(target, buf->id);
+    glBufferSubData(target, buf->offset + (size_t) offset * dim * compSize,
+                    (size_t) size * compSize, data);
+    buf->version = -1;
 }
 
 void GLShader::downloadAttrib(const std::string &name, uint32_t size, int /* dim */,
                              uint32_t compSize, GLuint /* glType */, uint8_t *data) {
-    auto it = mBufferObjects.find(name);
-    if (it == mBufferObjects.end())
+    const Buffer *found = findBuffer(name);
+    if (!found)
         throw std::runtime_error("downloadAttrib(" + mName + ", " + name + ") : buffer not found!");
 
-    const Buffer &buf = it->second;
+    const Buffer &buf = *found;
     if (buf.size != size || buf.compSize != compSize)
         throw std::runtime_error(mName + ": downloadAttrib: size mismatch!");
 
@@ -208,47 +988,65 @@ void GLShader::downloadAttrib(const std::string &name, uint32_t size, int /* dim
 
     if (name == "indices") {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buf.id);
-        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, totalSize, data);
+        glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, buf.offset, totalSize, data);
     } else {
         glBindBuffer(GL_ARRAY_BUFFER, buf.id);
-        glGetBufferSubData(GL_ARRAY_BUFFER, 0, totalSize, data);
+        glGetBufferSubData(GL_ARRAY_BUFFER, buf.offset, totalSize, data);
     }
 }
 
+void GLShader::downloadAttribAsync(const std::string &name,
+                                   const std::function<void(const uint8_t *, size_t)> &callback) {
+    const Buffer *buf = findBuffer(name);
+    if (!buf)
+        throw std::runtime_error("downloadAttribAsync(" + mName + ", " + name + ") : buffer not found!");
+
+    /* Interleaved buffers store their size in bytes (compSize == 1) */
+    GLReadback::readBuffer(buf->id, buf->offset, (size_t) buf->size * (size_t) buf->compSize, callback);
+}
+
 void GLShader::shareAttrib(const GLShader &otherShader, const std::string &name, const std::string &_as) {
     std::string as = _as.length() == 0 ? name : _as;
-    auto it = otherShader.mBufferObjects.find(name);
-    if (it == otherShader.mBufferObjects.end())
+    const Buffer *found = otherShader.findBuffer(name);
+    if (!found)
         throw std::runtime_error("shareAttribute(" + otherShader.mName + ", " + name + "): attribute not found!");
-    const Buffer &buffer = it->second;
+    const Buffer &buffer = *found;
 
-    if (name != "indices") {
+    if (name == "indices") {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id);
+        mIndexOffset = buffer.offset;
+    } else if (!buffer.layout.attributes().empty()) {
+        /* Interleaved buffers are shared under their attribute names */
+        bindAttribPointers(buffer);
+    } else {
         int attribID = attrib(as);
         if (attribID < 0)
             return;
         glEnableVertexAttribArray(attribID);
         glBindBuffer(GL_ARRAY_BUFFER, buffer.id);
-        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, buffer.compSize == 1 ? GL_TRUE : GL_FALSE, 0, 0);
-    } else {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.id);
+        glVertexAttribPointer(attribID, buffer.dim, buffer.glType, buffer.compSize == 1 ? GL_TRUE : GL_FALSE, 0,
+                              (const void *) buffer.offset);
+        glVertexAttribDivisor(attribID, buffer.divisor);
     }
 }
 
 void GLShader::invalidateAttribs() {
     for (auto &buffer : mBufferObjects)
-        buffer.second.version = -1;
+        buffer.version = -1;
 }
 
 void GLShader::freeAttrib(const std::string &name) {
-    auto it = mBufferObjects.find(name);
-    if (it != mBufferObjects.end()) {
-        glDeleteBuffers(1, &it->second.id);
-        mBufferObjects.erase(it);
+    for (auto it = mBufferObjects.begin(); it != mBufferObjects.end(); ++it) {
+        if (it->name == name) {
+            releaseBuffer(*it);
+            mBufferObjects.erase(it);
+            break;
+        }
     }
 }
 
 void GLShader::drawIndexed(int type, uint32_t offset_, uint32_t count_) {
-    if (count_ == 0)
+    if (count_ == 0 || mAsync)
         return;
     size_t offset = offset_;
     size_t count = count_;
@@ -259,40 +1057,79 @@ void GLShader::drawIndexed(int type, uint32_t offset_, uint32_t count_) {
     }
 
     glDrawElements(type, (GLsizei) count, GL_UNSIGNED_INT,
-                   (const void *)(offset * sizeof(uint32_t)));
+                   (const void *)(mIndexOffset + offset * sizeof(uint32_t)));
 }
 
 void GLShader::drawArray(int type, uint32_t offset, uint32_t count) {
-    if (count == 0)
+    if (count == 0 || mAsync)
         return;
 
     glDrawArrays(type, offset, count);
 }
 
+void GLShader::drawIndexedInstanced(int type, uint32_t offset_, uint32_t count_, uint32_t instanceCount) {
+    if (count_ == 0 || instanceCount == 0 || mAsync)
+        return;
+    size_t offset = offset_;
+    size_t count = count_;
+
+    switch (type) {
+        case GL_TRIANGLES: offset *= 3; count *= 3; break;
+        case GL_LINES: offset *= 2; count *= 2; break;
+    }
+
+    glDrawElementsInstanced(type, (GLsizei) count, GL_UNSIGNED_INT,
+                            (const void *)(mIndexOffset + offset * sizeof(uint32_t)),
+                            (GLsizei) instanceCount);
+}
+
+void GLShader::drawArrayInstanced(int type, uint32_t offset, uint32_t count, uint32_t instanceCount) {
+    if (count == 0 || instanceCount == 0 || mAsync)
+        return;
+
+    glDrawArraysInstanced(type, offset, count, instanceCount);
+}
+
 void GLShader::free() {
+    if (mAsync)
+        cancelAsync();
     for (auto &buf: mBufferObjects)
-        glDeleteBuffers(1, &buf.second.id);
+        releaseBuffer(buf);
+    mBufferObjects.clear();
+    mIndexOffset = 0;
+    mUniforms.clear();
+    mAttribs.clear();
 
     if (mVertexArrayObject)
         glDeleteVertexArrays(1, &mVertexArrayObject);
 
-    glDeleteProgram(mProgramShader); mProgramShader = 0;
+    auto it = __nanogui_programs.find(std::make_pair(glfwGetCurrentContext(), mProgramKey));
+    if (mProgramKey && it != __nanogui_programs.end() && it->second.program == mProgramShader) {
+        if (--it->second.refCount == 0) {
+            glDeleteProgram(mProgramShader);
+            __nanogui_programs.erase(it);
+        }
+    } else {
+        glDeleteProgram(mProgramShader);
+    }
+    mProgramShader = 0; mProgramKey = 0;
     glDeleteShader(mVertexShader);   mVertexShader = 0;
     glDeleteShader(mFragmentShader); mFragmentShader = 0;
     glDeleteShader(mGeometryShader); mGeometryShader = 0;
 }
 
-void GLFramebuffer::init(const Vector2i &size, int nSamples) {
-    mSize = size;
+void GLFramebuffer::init(const Vector2i &size, int nSamples, GLenum colorFormat) {
+    mSize = mAllocatedSize = size;
     mSamples = nSamples;
+    mColorFormat = colorFormat;
 
     glGenRenderbuffers(1, &mColor);
     glBindRenderbuffer(GL_RENDERBUFFER, mColor);
 
     if (nSamples == 1)
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+        glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, size.x, size.y);
     else
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, nSamples, GL_RGBA8, size.x, size.y);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, nSamples, colorFormat, size.x, size.y);
 
     glGenRenderbuffers(1, &mDepth);
     glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
@@ -320,8 +1157,16 @@ void GLFramebuffer::init(const Vector2i &size, int nSamples) {
 }
     
 void GLFramebuffer::free() {
+    glDeleteFramebuffers(1, &mFramebuffer);
     glDeleteRenderbuffers(1, &mColor);
     glDeleteRenderbuffers(1, &mDepth);
+    mFramebuffer = mColor = mDepth = 0;
+
+    if (mResolveFramebuffer) {
+        glDeleteFramebuffers(1, &mResolveFramebuffer);
+        glDeleteRenderbuffers(1, &mResolveColor);
+        mResolveFramebuffer = mResolveColor = 0;
+    }
 }
 
 void GLFramebuffer::bind() {
@@ -347,4 +1192,253 @@ void GLFramebuffer::blit() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void GLFramebuffer::readPixelsAsync(const std::function<void(const Vector2i &, const uint8_t *)> &callback) {
+    GLint previousRead, previousDraw;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+
+    if (mSamples > 1) {
+        if (!mResolveFramebuffer) {
+            glGenRenderbuffers(1, &mResolveColor);
+            glBindRenderbuffer(GL_RENDERBUFFER, mResolveColor);
+            glRenderbufferStorage(GL_RENDERBUFFER, mColorFormat, mAllocatedSize.x, mAllocatedSize.y);
+            glGenFramebuffers(1, &mResolveFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mResolveFramebuffer);
+            glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                      GL_RENDERBUFFER, mResolveColor);
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mResolveFramebuffer);
+        glBlitFramebuffer(0, 0, mSize.x, mSize.y, 0, 0, mSize.x, mSize.y,
+                          GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mResolveFramebuffer);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    }
+
+    Vector2i size = mSize;
+    GLReadback::readPixels(Vector2i(0, 0), size,
+        [callback, size](const uint8_t *data, size_t) { callback(size, data); });
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+}
+
+Vector2i GLFramebufferPool::bucket(const Vector2i &size) const {
+    int g = std::max(mGranularity, 1);
+    return Vector2i(std::max((size.x + g - 1) / g, 1) * g,
+                    std::max((size.y + g - 1) / g, 1) * g);
+}
+
+ref<GLFramebuffer> GLFramebufferPool::acquire(const Vector2i &size, int nSamples,
+                                              GLenum colorFormat) {
+    Vector2i target = bucket(size);
+
+    /* Prefer the exact bucket, otherwise the smallest larger one that doesn't waste too much */
+    auto best = mFree.end();
+    long bestArea = 0;
+    for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+        const GLFramebuffer &fb = *it->framebuffer;
+        if (fb.samples() != nSamples || fb.colorFormat() != colorFormat)
+            continue;
+        const Vector2i &alloc = fb.allocatedSize();
+        if (alloc.x < target.x || alloc.y < target.y)
+            continue;
+        long area = (long) alloc.x * alloc.y;
+        if (area > 2 * (long) target.x * target.y)
+            continue;
+        if (best == mFree.end() || area < bestArea) {
+            best = it;
+            bestArea = area;
+        }
+    }
+
+    ref<GLFramebuffer> framebuffer;
+    if (best != mFree.end()) {
+        framebuffer = best->framebuffer;
+        mFree.erase(best);
+    } else {
+        framebuffer = makeref<GLFramebuffer>();
+        framebuffer->init(target, nSamples, colorFormat);
+    }
+    framebuffer->mSize = size;
+    return framebuffer;
+}
+
+void GLFramebufferPool::release(const ref<GLFramebuffer> &framebuffer) {
+    if (framebuffer && framebuffer->ready())
+        mFree.push_back(Entry { framebuffer, mFrame });
+}
+
+void GLFramebufferPool::collect() {
+    mFrame++;
+    for (auto it = mFree.begin(); it != mFree.end(); ) {
+        if (mFrame - it->releasedFrame > (uint64_t) mRetainFrames) {
+            it->framebuffer->free();
+            it = mFree.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void GLFramebufferPool::clear() {
+    for (auto &entry : mFree)
+        entry.framebuffer->free();
+    mFree.clear();
+}
+
+struct PendingReadback {
+    GLFWwindow *context;
+    GLuint buffer;
+    size_t size;
+    GLsync fence;
+    GLReadback::Callback callback;
+};
+
+struct PooledReadbackBuffer {
+    GLFWwindow *context;
+    GLuint buffer;
+    size_t capacity;
+};
+
+static std::vector<PendingReadback> __nanogui_readbacks;
+static std::vector<PooledReadbackBuffer> __nanogui_readback_pool;
+
+/* Reuse a pack buffer of this context so that streamed captures don't reallocate */
+static GLuint acquireReadbackBuffer(size_t size) {
+    GLFWwindow *context = glfwGetCurrentContext();
+    for (auto it = __nanogui_readback_pool.begin(); it != __nanogui_readback_pool.end(); ++it) {
+        if (it->context == context && it->capacity == size) {
+            GLuint buffer = it->buffer;
+            __nanogui_readback_pool.erase(it);
+            return buffer;
+        }
+    }
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return buffer;
+}
+
+static void submitReadback(GLuint buffer, size_t size, const GLReadback::Callback &callback) {
+    PendingReadback readback;
+    readback.context = glfwGetCurrentContext();
+    readback.buffer = buffer;
+    readback.size = size;
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.callback = callback;
+    __nanogui_readbacks.push_back(readback);
+    /* Make sure the main loop comes around again to deliver the data */
+    glfwPostEmptyEvent();
+}
+
+void GLReadback::readPixels(const Vector2i &offset, const Vector2i &size,
+                            const Callback &callback) {
+    size_t bytes = (size_t) size.x * (size_t) size.y * 4;
+    if (bytes == 0)
+        return;
+    GLuint buffer = acquireReadbackBuffer(bytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    GLint alignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(offset.x, offset.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    submitReadback(buffer, bytes, callback);
+}
+
+void GLReadback::readBuffer(GLuint source, size_t offset, size_t size,
+                            const Callback &callback) {
+    if (size == 0)
+        return;
+    GLuint buffer = acquireReadbackBuffer(size);
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    submitReadback(buffer, size, callback);
+}
+
+size_t GLReadback::process(bool wait) {
+    GLFWwindow *context = glfwGetCurrentContext();
+    size_t remaining = 0;
+
+    /* Callbacks may issue new readbacks, so detach the completed ones first */
+    std::vector<PendingReadback> completed;
+    for (auto it = __nanogui_readbacks.begin(); it != __nanogui_readbacks.end(); ) {
+        if (it->context != context) {
+            ++it;
+            continue;
+        }
+        GLenum result = glClientWaitSync(it->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                          wait ? GL_TIMEOUT_IGNORED : 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            completed.push_back(*it);
+            it = __nanogui_readbacks.erase(it);
+        } else {
+            ++remaining;
+            ++it;
+        }
+    }
+
+    for (auto &readback : completed) {
+        glDeleteSync(readback.fence);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const uint8_t *data = (const uint8_t *) glMapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, readback.size, GL_MAP_READ_BIT);
+        if (data)
+            readback.callback(data, readback.size);
+        else
+            std::cerr << "GLReadback: could not map pack buffer!" << std::endl;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        __nanogui_readback_pool.push_back(
+            PooledReadbackBuffer { context, readback.buffer, readback.size });
+    }
+
+    /* Keep the pool bounded: a few captures in flight is all that's needed */
+    const size_t maxPooled = 8;
+    while (__nanogui_readback_pool.size() > maxPooled) {
+        auto it = std::find_if(__nanogui_readback_pool.begin(), __nanogui_readback_pool.end(),
+            [context](const PooledReadbackBuffer &b) { return b.context == context; });
+        if (it == __nanogui_readback_pool.end())
+            break;
+        glDeleteBuffers(1, &it->buffer);
+        __nanogui_readback_pool.erase(it);
+    }
+
+    if (remaining > 0)
+        glfwPostEmptyEvent();
+
+    return remaining;
+}
+
+void GLReadback::clear() {
+    GLFWwindow *context = glfwGetCurrentContext();
+    for (auto it = __nanogui_readbacks.begin(); it != __nanogui_readbacks.end(); ) {
+        if (it->context == context) {
+            glDeleteSync(it->fence);
+            glDeleteBuffers(1, &it->buffer);
+            it = __nanogui_readbacks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = __nanogui_readback_pool.begin(); it != __nanogui_readback_pool.end(); ) {
+        if (it->context == context) {
+            glDeleteBuffers(1, &it->buffer);
+            it = __nanogui_readback_pool.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 }; /* namespace nanogui */
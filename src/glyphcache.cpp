@@ -0,0 +1,180 @@
+/*
+    src/glyphcache.cpp -- Pre-rasterizes declared glyph sets into the
+    NanoVG font atlas so that the first frames do not stutter
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/glyphcache.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Glyphs submitted per nvgText() call while warming */
+static const int __glyph_chunk_size = 32;
+
+/* Initial and maximum font atlas sizes of NanoVG, and the fraction of the
+   atlas its skyline packer typically manages to fill */
+static const int __glyph_atlas_initial = 512;
+static const int __glyph_atlas_max = 2048;
+static const double __glyph_atlas_efficiency = 0.75;
+
+static const char *__glyph_manifest_magic = "nanogui-glyphs";
+
+static std::map<NVGcontext *, std::unique_ptr<GlyphCache>> __nanogui_glyph_caches;
+
+GlyphCache &GlyphCache::get(NVGcontext *ctx) {
+    auto &cache = __nanogui_glyph_caches[ctx];
+    if (!cache)
+        cache.reset(new GlyphCache(ctx));
+    return *cache;
+}
+
+GlyphCache *GlyphCache::find(NVGcontext *ctx) {
+    auto it = __nanogui_glyph_caches.find(ctx);
+    return it == __nanogui_glyph_caches.end() ? nullptr : it->second.get();
+}
+
+void GlyphCache::release(NVGcontext *ctx) {
+    __nanogui_glyph_caches.erase(ctx);
+}
+
+void GlyphCache::declare(const std::string &font, float size, const std::vector<Range> &ranges) {
+    for (auto const &range : ranges) {
+        mDeclarations.push_back(Declaration { font, size, range });
+        for (uint32_t c = range.first; c <= range.last && c <= 0x10FFFF; ++c) {
+            if (mKnown.insert(std::make_tuple(font, size, c)).second)
+                mQueue.push_back(Glyph { font, size, c });
+        }
+    }
+}
+
+static void utf8_append_helper(std::string &str, uint32_t c) {
+    if (c < 0x80) {
+        str += (char) c;
+    } else if (c < 0x800) {
+        str += (char) (0xC0 | (c >> 6));
+        str += (char) (0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        str += (char) (0xE0 | (c >> 12));
+        str += (char) (0x80 | ((c >> 6) & 0x3F));
+        str += (char) (0x80 | (c & 0x3F));
+    } else {
+        str += (char) (0xF0 | (c >> 18));
+        str += (char) (0x80 | ((c >> 12) & 0x3F));
+        str += (char) (0x80 | ((c >> 6) & 0x3F));
+        str += (char) (0x80 | (c & 0x3F));
+    }
+}
+
+void GlyphCache::prewarm(float pixelRatio, double budget) {
+    if (mQueue.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    /* Text is drawn fully transparent and scissored away: NanoVG still
+       rasterizes every glyph into its atlas, but nothing reaches the screen */
+    nvgSave(mContext);
+    nvgResetTransform(mContext);
+    nvgScissor(mContext, 0, 0, 0, 0);
+    nvgFillColor(mContext, nvgRGBA(0, 0, 0, 0));
+    nvgFontBlur(mContext, 0);
+    nvgTextAlign(mContext, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+
+    std::string text;
+    while (!mQueue.empty()) {
+        const Glyph front = mQueue.front();
+        text.clear();
+        int count = 0;
+        while (!mQueue.empty() && count < __glyph_chunk_size &&
+               mQueue.front().font == front.font && mQueue.front().size == front.size) {
+            uint32_t c = mQueue.front().codepoint;
+            if (c >= 0x20 && (c < 0xD800 || c > 0xDFFF)) {
+                utf8_append_helper(text, c);
+                count++;
+            }
+            mQueue.pop_front();
+        }
+
+        if (count == 0 || nvgFindFont(mContext, front.font.c_str()) < 0)
+            continue;
+
+        nvgFontFace(mContext, front.font.c_str());
+        nvgFontSize(mContext, front.size);
+        float advance = nvgText(mContext, 0, 0, text.c_str(), nullptr);
+
+        /* Every glyph occupies roughly its advance times the line height,
+           plus the padding fontstash adds around each bitmap */
+        float lineh = 0;
+        nvgTextMetrics(mContext, nullptr, nullptr, &lineh);
+        mArea += (advance * pixelRatio + 2.0 * count) * (lineh * pixelRatio + 2.0);
+        mWarmed += count;
+
+        if (budget >= 0) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() > budget)
+                break;
+        }
+    }
+
+    nvgRestore(mContext);
+}
+
+bool GlyphCache::loadManifest(const std::string &path) {
+    std::ifstream is(path);
+    std::string magic;
+    int version = 0;
+    if (!(is >> magic >> version) || magic != __glyph_manifest_magic || version != 1)
+        return false;
+
+    std::string font;
+    float size;
+    Range range;
+    while (is >> font >> size >> range.first >> range.last)
+        declare(font, size, { range });
+    return true;
+}
+
+bool GlyphCache::saveManifest(const std::string &path) const {
+    std::ofstream os(path);
+    if (!os)
+        return false;
+    os << __glyph_manifest_magic << " 1" << std::endl;
+    for (auto const &decl : mDeclarations)
+        os << decl.font << " " << decl.size << " " << decl.range.first << " "
+           << decl.range.last << std::endl;
+    return (bool) os;
+}
+
+GlyphCache::Stats GlyphCache::stats() const {
+    Stats stats;
+    stats.glyphsWarmed = mWarmed;
+    stats.glyphsPending = mQueue.size();
+    stats.area = (size_t) mArea;
+
+    /* Replay how NanoVG grows its atlas (alternating between the two axes) */
+    int w = __glyph_atlas_initial, h = __glyph_atlas_initial;
+    while ((double) w * h * __glyph_atlas_efficiency < mArea &&
+           (w < __glyph_atlas_max || h < __glyph_atlas_max)) {
+        if (w > h)
+            h *= 2;
+        else
+            w *= 2;
+        stats.atlasResizes++;
+    }
+    stats.atlasSize = Vector2i(w, h);
+    stats.occupancy = (float) std::min(1.0, mArea / ((double) w * h));
+    return stats;
+}
+
+NAMESPACE_END(nanogui)
@@ -22,6 +22,19 @@ Graph::Graph(ref<Widget> parent, const std::string &caption)
     mTextColor = Color(240, 192);
 }
 
+void Graph::bind(RingBuffer<float> &source, size_t history) {
+    unbind();
+    mSource = &source;
+    mHistory = history ? history : source.capacity();
+    const RingBuffer<float> *src = mSource;
+    mWatch.reset(new TelemetryWatch([src]() { return !src->empty(); }));
+}
+
+void Graph::unbind() {
+    mWatch.reset();
+    mSource = nullptr;
+}
+
 Vector2i Graph::preferredSize(NVGcontext *) const {
     return Vector2i(180, 45);
 }
@@ -29,6 +42,15 @@ Vector2i Graph::preferredSize(NVGcontext *) const {
 void Graph::draw(NVGcontext *ctx) {
     Widget::draw(ctx);
 
+    if (mSource) {
+        float value;
+        while (mSource->pop(value))
+            mValues.push_back(value);
+        if (mValues.size() > mHistory)
+            mValues.erase(mValues.begin(), mValues.end() - mHistory);
+        mWatch->rearm();
+    }
+
     nvgBeginPath(ctx);
     nvgRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y);
     nvgFillColor(ctx, mBackgroundColor);
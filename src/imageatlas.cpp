@@ -0,0 +1,376 @@
+/*
+    src/imageatlas.cpp -- Packs small images (icons, unit images,
+    thumbnails) into shared NanoVG textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/imageatlas.h>
+#include <nanogui/layoutpool.h>
+#include <nanogui/opengl.h>
+#include <stb_image.h> /* Implementation is compiled into nanovg.c */
+#include <cstring>
+
+/* Declarations only; the implementation is compiled into screen.cpp */
+#if !defined(NANOVG_GL3)
+#  define NANOVG_GL3
+#endif
+#include <nanovg_gl.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Live entries migrated per frame while repacking a fragmented page */
+static const int __atlas_repack_budget = 32;
+
+static std::map<NVGcontext *, std::unique_ptr<ImageAtlas>> __nanogui_atlases;
+
+/* Context -> context owning the atlas it shares */
+static std::map<NVGcontext *, NVGcontext *> __nanogui_atlas_shares;
+
+ImageAtlas &ImageAtlas::get(NVGcontext *ctx) {
+    auto &atlas = __nanogui_atlases[owner(ctx)];
+    if (!atlas)
+        atlas.reset(new ImageAtlas(owner(ctx)));
+    return *atlas;
+}
+
+ImageAtlas *ImageAtlas::find(NVGcontext *ctx) {
+    auto it = __nanogui_atlases.find(owner(ctx));
+    return it == __nanogui_atlases.end() ? nullptr : it->second.get();
+}
+
+void ImageAtlas::release(NVGcontext *ctx) {
+    auto it = __nanogui_atlas_shares.find(ctx);
+    if (it != __nanogui_atlas_shares.end()) {
+        if (ImageAtlas *atlas = find(it->second))
+            atlas->releaseShared(ctx);
+        __nanogui_atlas_shares.erase(it);
+        return;
+    }
+    __nanogui_atlases.erase(ctx);
+}
+
+void ImageAtlas::share(NVGcontext *ctx, NVGcontext *owner) {
+    if (ctx != owner)
+        __nanogui_atlas_shares[ctx] = ImageAtlas::owner(owner);
+}
+
+NVGcontext *ImageAtlas::owner(NVGcontext *ctx) {
+    auto it = __nanogui_atlas_shares.find(ctx);
+    return it == __nanogui_atlas_shares.end() ? ctx : it->second;
+}
+
+ImageAtlas::~ImageAtlas() {
+    for (auto &page : mPages) {
+        if (page.image)
+            nvgDeleteImage(mContext, page.image);
+    }
+}
+
+int ImageAtlas::add(const std::string &name, const uint8_t *data, uint32_t size) {
+    auto it = mNames.find(name);
+    if (it != mNames.end())
+        return it->second;
+
+    int w, h, n;
+    uint8_t *rgba = stbi_load_from_memory(data, (int) size, &w, &h, &n, 4);
+    if (!rgba)
+        return 0;
+    int id = addRGBA(name, w, h, rgba);
+    stbi_image_free(rgba);
+    return id;
+}
+
+int ImageAtlas::lookup(const std::string &name) const {
+    auto it = mNames.find(name);
+    return it != mNames.end() ? it->second : 0;
+}
+
+int ImageAtlas::addRGBA(const std::string &name, int width, int height, const uint8_t *rgba) {
+    auto it = mNames.find(name);
+    if (it != mNames.end())
+        return it->second;
+    if (width <= 0 || height <= 0 || width > MaxImageSize || height > MaxImageSize)
+        return 0;
+
+    Entry entry;
+    entry.name = name;
+    entry.size = Vector2i(width, height);
+    if (!allocate(entry.size, entry.page, entry.pos, -1))
+        return 0;
+    blit(entry, rgba, width * 4);
+
+    int id = mNextID--;
+    mEntries[id] = entry;
+    mNames[name] = id;
+    return id;
+}
+
+void ImageAtlas::remove(int id) {
+    auto it = mEntries.find(id);
+    if (it == mEntries.end())
+        return;
+
+    const Entry &entry = it->second;
+    Page &page = mPages[entry.page];
+    page.freedArea += (size_t) (entry.size.x + 2) * (size_t) (entry.size.y + 2);
+    page.entries--;
+
+    if (page.entries == 0) {
+        /* Nothing left: the whole page can be reused right away */
+        page.shelves.clear();
+        page.top = 0;
+        page.usedArea = page.freedArea = 0;
+        page.retiring = false;
+    } else if (page.freedArea * 2 > page.usedArea &&
+               page.usedArea * 8 > (size_t) PageSize * PageSize) {
+        page.retiring = true;
+    }
+
+    mNames.erase(entry.name);
+    mEntries.erase(it);
+}
+
+Vector2i ImageAtlas::imageSize(int id) const {
+    auto it = mEntries.find(id);
+    return it == mEntries.end() ? Vector2i(0, 0) : it->second.size;
+}
+
+NVGpaint ImageAtlas::pattern(NVGcontext *ctx, int id, float x, float y, float w, float h, float alpha) {
+    auto it = mEntries.find(id);
+    if (it == mEntries.end())
+        return nvgImagePattern(ctx, x, y, w, h, 0, 0, 0.f);
+
+    const Entry &entry = it->second;
+    Page &page = mPages[entry.page];
+    if (page.dirty) {
+        /* Added during this frame, upload before it gets drawn */
+        nvgUpdateImage(mContext, page.image, page.pixels.data());
+        page.dirty = false;
+    }
+
+    /* Scale the whole page so that the entry lands exactly on (x, y, w, h) */
+    float sx = w / entry.size.x, sy = h / entry.size.y;
+    return nvgImagePattern(ctx, x - entry.pos.x * sx, y - entry.pos.y * sy,
+                           PageSize * sx, PageSize * sy, 0, pageImage(ctx, entry.page), alpha);
+}
+
+int ImageAtlas::pageImage(NVGcontext *ctx, int page) {
+    int image = mPages[page].image;
+    if (ctx == mContext)
+        return image;
+
+    /* Wrap the page texture once per sharing context; pages are re-created
+       when repacking, so wrappers of a previous page image are replaced */
+    auto &shared = mShared[std::make_pair(ctx, page)];
+    if (shared.second != image) {
+        if (shared.first)
+            nvgDeleteImage(ctx, shared.first);
+        shared = std::make_pair(nvgShareImage(ctx, mContext, image), image);
+    }
+    return shared.first;
+}
+
+void ImageAtlas::releaseShared(NVGcontext *ctx) {
+    for (auto it = mShared.begin(); it != mShared.end(); ) {
+        if (it->first.first == ctx) {
+            nvgDeleteImage(ctx, it->second.first);
+            it = mShared.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ImageAtlas::update() {
+    int budget = __atlas_repack_budget;
+
+    for (int p = 0; p < (int) mPages.size() && budget > 0; ++p) {
+        if (!mPages[p].retiring)
+            continue;
+
+        /* Migrate live entries off the fragmented page, a few per frame */
+        std::vector<uint8_t> scratch;
+        for (auto &kv : mEntries) {
+            Entry &entry = kv.second;
+            if (entry.page != p)
+                continue;
+            if (budget-- == 0)
+                break;
+
+            const Page &source = mPages[p];
+            int stride = entry.size.x * 4;
+            scratch.resize((size_t) stride * entry.size.y);
+            for (int y = 0; y < entry.size.y; ++y)
+                memcpy(&scratch[(size_t) y * stride],
+                       &source.pixels[((size_t) (entry.pos.y + y) * PageSize + entry.pos.x) * 4],
+                       stride);
+
+            Entry moved = entry;
+            if (!allocate(entry.size, moved.page, moved.pos, p))
+                return;
+            blit(moved, scratch.data(), stride);
+            entry = moved;
+
+            Page &page = mPages[p];
+            if (--page.entries == 0) {
+                page.shelves.clear();
+                page.top = 0;
+                page.usedArea = page.freedArea = 0;
+                page.retiring = false;
+            }
+        }
+    }
+
+    /* Keep one spare page around, release the textures of other empty pages */
+    bool spare = false;
+    for (auto &page : mPages) {
+        if (!page.image || page.entries > 0)
+            continue;
+        if (!spare) {
+            spare = true;
+            continue;
+        }
+        nvgDeleteImage(mContext, page.image);
+        page = Page();
+    }
+
+    for (auto &page : mPages) {
+        if (page.image && page.dirty) {
+            nvgUpdateImage(mContext, page.image, page.pixels.data());
+            page.dirty = false;
+        }
+    }
+}
+
+float ImageAtlas::fragmentation() const {
+    size_t used = 0, freed = 0;
+    for (auto const &page : mPages) {
+        used += page.usedArea;
+        freed += page.freedArea;
+    }
+    return used == 0 ? 0.f : (float) freed / (float) used;
+}
+
+int ImageAtlas::pageCount() const {
+    int count = 0;
+    for (auto const &page : mPages)
+        count += page.image != 0 ? 1 : 0;
+    return count;
+}
+
+bool ImageAtlas::allocate(const Vector2i &size, int &pageIndex, Vector2i &pos, int excludePage) {
+    /* Each entry is surrounded by a 1px border that replicates its edge
+       pixels, so that bilinear filtering never picks up a neighbor */
+    int w = size.x + 2, h = size.y + 2;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int p = 0; p < (int) mPages.size(); ++p) {
+            Page &page = mPages[p];
+            if (!page.image || page.retiring || p == excludePage)
+                continue;
+
+            /* First try to extend an existing shelf of similar height */
+            for (auto &shelf : page.shelves) {
+                if (shelf.height >= h && shelf.height <= h + h / 2 + 2 &&
+                    shelf.x + w <= PageSize) {
+                    pos = Vector2i(shelf.x + 1, shelf.y + 1);
+                    shelf.x += w;
+                    pageIndex = p;
+                    page.usedArea += (size_t) w * h;
+                    page.entries++;
+                    return true;
+                }
+            }
+
+            /* Otherwise open a new shelf */
+            if (page.top + h <= PageSize) {
+                page.shelves.push_back(Shelf { page.top, h, w });
+                pos = Vector2i(1, page.top + 1);
+                page.top += h;
+                pageIndex = p;
+                page.usedArea += (size_t) w * h;
+                page.entries++;
+                return true;
+            }
+        }
+
+        if (pass == 0 && newPage() < 0)
+            return false;
+    }
+    return false;
+}
+
+int ImageAtlas::newPage() {
+    int index = -1;
+    for (int p = 0; p < (int) mPages.size(); ++p) {
+        if (!mPages[p].image) {
+            index = p;
+            break;
+        }
+    }
+    if (index < 0) {
+        mPages.push_back(Page());
+        index = (int) mPages.size() - 1;
+    }
+
+    Page &page = mPages[index];
+    page.pixels.assign((size_t) PageSize * PageSize * 4, 0);
+    page.image = nvgCreateImageRGBA(mContext, PageSize, PageSize, 0, page.pixels.data());
+    if (!page.image) {
+        page = Page();
+        return -1;
+    }
+    return index;
+}
+
+void ImageAtlas::blit(Entry &entry, const uint8_t *rgba, int stride) {
+    Page &page = mPages[entry.page];
+    int w = entry.size.x, h = entry.size.y;
+
+    for (int y = -1; y <= h; ++y) {
+        int sy = std::min(std::max(y, 0), h - 1);
+        uint8_t *dst = &page.pixels[((size_t) (entry.pos.y + y) * PageSize + entry.pos.x - 1) * 4];
+        const uint8_t *src = rgba + (size_t) sy * stride;
+        memcpy(dst, src, 4);
+        memcpy(dst + 4, src, (size_t) w * 4);
+        memcpy(dst + (size_t) (w + 1) * 4, src + (size_t) (w - 1) * 4, 4);
+    }
+    page.dirty = true;
+}
+
+void nvgImageIconSize(NVGcontext *ctx, int image, int *w, int *h) {
+    if (ImageAtlas::isAtlasImage(image)) {
+        /* Also called during parallel layout with a measurement context */
+        ImageAtlas *atlas = ImageAtlas::find(LayoutPool::mainContext(ctx));
+        Vector2i size = atlas ? atlas->imageSize(image) : Vector2i(0, 0);
+        *w = size.x;
+        *h = size.y;
+    } else {
+        nvgImageSize(ctx, image, w, h);
+    }
+}
+
+int nvgShareImage(NVGcontext *ctx, NVGcontext *source, int image) {
+    int w = 0, h = 0;
+    nvgImageSize(source, image, &w, &h);
+    return nvglCreateImageFromHandleGL3(ctx, nvglImageHandleGL3(source, image), w, h,
+                                        NVG_IMAGE_NODELETE);
+}
+
+NVGpaint nvgImageIconPattern(NVGcontext *ctx, int image, float x, float y,
+                             float w, float h, float alpha) {
+    if (ImageAtlas::isAtlasImage(image)) {
+        ImageAtlas *atlas = ImageAtlas::find(ctx);
+        if (atlas)
+            return atlas->pattern(ctx, image, x, y, w, h, alpha);
+    }
+    return nvgImagePattern(ctx, x, y, w, h, 0, image, alpha);
+}
+
+NAMESPACE_END(nanogui)
@@ -12,6 +12,7 @@
 
 #include <nanogui/imagepanel.h>
 #include <nanogui/opengl.h>
+#include <nanogui/imageatlas.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -69,7 +70,7 @@ void ImagePanel::draw(NVGcontext* ctx) {
             Vector2i((int) i % grid.x, (int) i / grid.x) * (mThumbSize + mSpacing);
         int imgw, imgh;
 
-        nvgImageSize(ctx, mImages[i].first, &imgw, &imgh);
+        nvgImageIconSize(ctx, mImages[i].first, &imgw, &imgh);
         float iw, ih, ix, iy;
         if (imgw < imgh) {
             iw = mThumbSize;
@@ -83,9 +84,9 @@ void ImagePanel::draw(NVGcontext* ctx) {
             iy = 0;
         }
 
-        NVGpaint imgPaint = nvgImagePattern(
-            ctx, p.x + ix, p.y+ iy, iw, ih, 0, mImages[i].first,
-            mMouseIndex == (int)i ? 1.0 : 0.7);
+        NVGpaint imgPaint = nvgImageIconPattern(
+            ctx, mImages[i].first, p.x + ix, p.y+ iy, iw, ih,
+            mMouseIndex == (int)i ? 1.0f : 0.7f);
 
         nvgBeginPath(ctx);
         nvgRoundedRect(ctx, p.x, p.y, mThumbSize, mThumbSize, 5);
@@ -12,6 +12,7 @@
 
 #include <nanogui/imageview.h>
 #include <nanogui/opengl.h>
+#include <nanogui/imageatlas.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -22,7 +23,7 @@ Vector2i ImageView::preferredSize(NVGcontext *ctx) {
     if (!mImage)
         return Vector2i(0, 0);
     int w,h;
-    nvgImageSize(ctx, mImage, &w, &h);
+    nvgImageIconSize(ctx, mImage, &w, &h);
     return Vector2i(w, h);
 }
 
@@ -33,7 +34,7 @@ void ImageView::draw(NVGcontext* ctx) {
     Vector2i s = Widget::size();
 
     int w, h;
-    nvgImageSize(ctx, mImage, &w, &h);
+    nvgImageIconSize(ctx, mImage, &w, &h);
 
     if (mPolicy == SizePolicy::Fixed) {
         if (s.x < w) {
@@ -57,7 +58,7 @@ void ImageView::draw(NVGcontext* ctx) {
         }
     }
 
-    NVGpaint imgPaint = nvgImagePattern(ctx, p.x, p.y, w, h, 0, mImage, 1.0);
+    NVGpaint imgPaint = nvgImageIconPattern(ctx, mImage, p.x, p.y, w, h, 1.0f);
 
     nvgBeginPath(ctx);
     nvgRect(ctx, p.x, p.y, w, h);
@@ -12,6 +12,7 @@
 #include <nanogui/label.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/sdftext.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -24,14 +25,14 @@ Label::Label(ref<Widget> parent, const std::string &caption, const std::string &
 Vector2i Label::preferredSize(NVGcontext *ctx) {
     if (mCaption == "")
         return Vector2i(0);
-    nvgFontSize(ctx,fontSize());
-    nvgFontFace(ctx, mFont.c_str());
     if (mFixedSize.x > 0) {
         float bounds[4];
-        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-        nvgTextBoxBounds(ctx, 0, 0, mFixedSize.x, mCaption.c_str(), nullptr, bounds);
+        mLayout.update(ctx, mCaption, mFont, fontSize(), mFixedSize.x);
+        mLayout.bounds(0, 0, NVG_ALIGN_LEFT, bounds);
         return Vector2i(mFixedSize.x, bounds[3]-bounds[1]);
     } else {
+        nvgFontSize(ctx,fontSize());
+        nvgFontFace(ctx, mFont.c_str());
         nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
         return Vector2i(nvgTextBounds(ctx, 0, 0, mCaption.c_str(), nullptr, nullptr), mTheme->mStandardFontSize);
     }
@@ -39,15 +40,17 @@ Vector2i Label::preferredSize(NVGcontext *ctx) {
 
 void Label::draw(NVGcontext *ctx) {
     //Widget::draw(ctx);
-    nvgFontSize(ctx, fontSize());
-    nvgFontFace(ctx, mFont.c_str());
-    nvgFillColor(ctx, mColor);
+    if (mSample) {
+        mSample();
+        mWatch->rearm();
+    }
     if (mFixedSize.x > 0) {
-        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-        nvgTextBox(ctx, mPos.x, mPos.y, mFixedSize.x, mCaption.c_str(), nullptr);
+        nvgFillColor(ctx, mColor);
+        mLayout.update(ctx, mCaption, mFont, fontSize(), mFixedSize.x);
+        mLayout.draw(ctx, mPos.x, mPos.y, NVG_ALIGN_LEFT);
     } else {
-        nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE);
-        nvgText(ctx, mPos.x, mPos.y + mSize.y * 0.5f, mCaption.c_str(), nullptr);
+        nvgBatchText(ctx, mPos.x, mPos.y + mSize.y * 0.5f, mFont, fontSize(),
+                     NVG_ALIGN_LEFT | NVG_ALIGN_MIDDLE, mColor, mCaption.c_str());
     }
 }
 
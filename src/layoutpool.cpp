@@ -0,0 +1,299 @@
+/*
+    src/layoutpool.cpp -- Worker threads with private text measurement
+    contexts for laying out independent windows in parallel
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/layoutpool.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Texture IDs handed out by the measurement renderers. They only name the
+   font atlas of a measurement context; every other ID is assumed to belong
+   to the main context. */
+static const int __measure_texture_base = 1 << 24;
+
+static std::map<NVGcontext *, std::unique_ptr<LayoutPool>> __nanogui_layout_pools;
+
+/* Measurement context -> main context (only modified while no layout runs) */
+static std::map<NVGcontext *, NVGcontext *> __nanogui_measure_contexts;
+
+/* NanoVG renderer without any output: keeps track of texture sizes for the
+   font stash and forwards everything else to the main context */
+struct MeasureRenderer {
+    NVGcontext *main = nullptr;
+    std::map<int, Vector2i> textures;
+    int nextTexture = __measure_texture_base;
+};
+
+struct LayoutPool::Worker {
+    std::thread thread;
+    NVGcontext *ctx = nullptr;
+    MeasureRenderer renderer;
+};
+
+static int measure_create_helper(void *) {
+    return 1;
+}
+
+static int measure_create_texture_helper(void *uptr, int, int w, int h, int, const unsigned char *) {
+    MeasureRenderer *renderer = (MeasureRenderer *) uptr;
+    int id = renderer->nextTexture++;
+    renderer->textures[id] = Vector2i(w, h);
+    return id;
+}
+
+static int measure_delete_texture_helper(void *uptr, int image) {
+    MeasureRenderer *renderer = (MeasureRenderer *) uptr;
+    return renderer->textures.erase(image) ? 1 : 0;
+}
+
+static int measure_update_texture_helper(void *, int, int, int, int, int, const unsigned char *) {
+    return 1;
+}
+
+static int measure_get_texture_size_helper(void *uptr, int image, int *w, int *h) {
+    MeasureRenderer *renderer = (MeasureRenderer *) uptr;
+    auto it = renderer->textures.find(image);
+    if (it != renderer->textures.end()) {
+        *w = it->second.x;
+        *h = it->second.y;
+    } else {
+        /* Read-only lookup. The main context is not used while layout runs
+           (run() measures with a context of its own on the calling thread),
+           and images cannot be created from a measurement context */
+        nvgImageSize(renderer->main, image, w, h);
+    }
+    return 1;
+}
+
+/* Signatures of the renderer interface of upstream NanoVG (with composite
+   operations and a fractional viewport), which ext/nanovg tracks */
+static void measure_viewport_helper(void *, float, float, float) { }
+static void measure_cancel_helper(void *) { }
+static void measure_flush_helper(void *) { }
+static void measure_fill_helper(void *, NVGpaint *, NVGcompositeOperationState, NVGscissor *,
+                                float, const float *, const NVGpath *, int) { }
+static void measure_stroke_helper(void *, NVGpaint *, NVGcompositeOperationState, NVGscissor *,
+                                  float, float, const NVGpath *, int) { }
+static void measure_triangles_helper(void *, NVGpaint *, NVGcompositeOperationState, NVGscissor *,
+                                     const NVGvertex *, int, float) { }
+static void measure_delete_helper(void *) { }
+
+LayoutPool &LayoutPool::get(NVGcontext *ctx) {
+    auto &pool = __nanogui_layout_pools[ctx];
+    if (!pool)
+        pool.reset(new LayoutPool(ctx));
+    return *pool;
+}
+
+LayoutPool *LayoutPool::find(NVGcontext *ctx) {
+    auto it = __nanogui_layout_pools.find(ctx);
+    return it == __nanogui_layout_pools.end() ? nullptr : it->second.get();
+}
+
+void LayoutPool::release(NVGcontext *ctx) {
+    __nanogui_layout_pools.erase(ctx);
+}
+
+NVGcontext *LayoutPool::mainContext(NVGcontext *ctx) {
+    auto it = __nanogui_measure_contexts.find(ctx);
+    return it == __nanogui_measure_contexts.end() ? ctx : it->second;
+}
+
+LayoutPool::LayoutPool(NVGcontext *ctx) : mContext(ctx) { }
+
+LayoutPool::~LayoutPool() {
+    stop();
+}
+
+static void load_font_helper(NVGcontext *ctx, const std::string &name, const uint8_t *data,
+                             size_t size, const std::string &filename) {
+    if (!filename.empty())
+        nvgCreateFont(ctx, name.c_str(), filename.c_str());
+    else
+        nvgCreateFontMem(ctx, name.c_str(), const_cast<uint8_t *>(data), (int) size, 0);
+}
+
+void LayoutPool::addFont(const std::string &name, const uint8_t *data, size_t size) {
+    mFonts.push_back(Font { name, data, size, "" });
+    for (Worker *worker : mWorkers)
+        load_font_helper(worker->ctx, name, data, size, "");
+    if (mCaller)
+        load_font_helper(mCaller->ctx, name, data, size, "");
+}
+
+void LayoutPool::addFontFile(const std::string &name, const std::string &filename) {
+    mFonts.push_back(Font { name, nullptr, 0, filename });
+    for (Worker *worker : mWorkers)
+        load_font_helper(worker->ctx, name, nullptr, 0, filename);
+    if (mCaller)
+        load_font_helper(mCaller->ctx, name, nullptr, 0, filename);
+}
+
+void LayoutPool::setThreadCount(int count) {
+    if (count == mThreadCount)
+        return;
+    stop();
+    mThreadCount = count;
+}
+
+int LayoutPool::threadCount() const {
+    if (mThreadCount > 0)
+        return mThreadCount;
+    return std::max((int) std::thread::hardware_concurrency() - 1, 1);
+}
+
+LayoutPool::Worker *LayoutPool::createWorker() {
+    Worker *worker = new Worker();
+    worker->renderer.main = mContext;
+
+    NVGparams params;
+    memset(&params, 0, sizeof(NVGparams));
+    params.userPtr = &worker->renderer;
+    params.edgeAntiAlias = 0;
+    params.renderCreate = measure_create_helper;
+    params.renderCreateTexture = measure_create_texture_helper;
+    params.renderDeleteTexture = measure_delete_texture_helper;
+    params.renderUpdateTexture = measure_update_texture_helper;
+    params.renderGetTextureSize = measure_get_texture_size_helper;
+    params.renderViewport = measure_viewport_helper;
+    params.renderCancel = measure_cancel_helper;
+    params.renderFlush = measure_flush_helper;
+    params.renderFill = measure_fill_helper;
+    params.renderStroke = measure_stroke_helper;
+    params.renderTriangles = measure_triangles_helper;
+    params.renderDelete = measure_delete_helper;
+
+    worker->ctx = nvgCreateInternal(&params);
+    if (!worker->ctx) {
+        delete worker;
+        throw std::runtime_error("LayoutPool: could not create a measurement context!");
+    }
+    for (const Font &font : mFonts)
+        load_font_helper(worker->ctx, font.name, font.data, font.size, font.filename);
+    __nanogui_measure_contexts[worker->ctx] = mContext;
+    return worker;
+}
+
+void LayoutPool::start() {
+    /* The calling thread measures with a context of its own as well, so
+       that the main context is left alone while layout runs */
+    mCaller = createWorker();
+
+    for (int i = 0; i < threadCount(); ++i) {
+        Worker *worker = createWorker();
+        mWorkers.push_back(worker);
+
+        int generation = mGeneration;
+        worker->thread = std::thread([this, worker, generation]() mutable {
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mJobCond.wait(lock, [&]() { return mStop || mGeneration != generation; });
+                    if (mStop)
+                        return;
+                    generation = mGeneration;
+                    mBusy++;
+                }
+                work(worker->ctx);
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (--mBusy == 0)
+                        mDoneCond.notify_all();
+                }
+            }
+        });
+    }
+}
+
+void LayoutPool::stop() {
+    if (!mCaller)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mJobCond.notify_all();
+    mWorkers.push_back(mCaller);
+    for (Worker *worker : mWorkers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+        __nanogui_measure_contexts.erase(worker->ctx);
+        nvgDeleteInternal(worker->ctx);
+        delete worker;
+    }
+    mWorkers.clear();
+    mCaller = nullptr;
+    mStop = false;
+}
+
+void LayoutPool::work(NVGcontext *ctx) {
+    while (true) {
+        const std::function<void(size_t, NVGcontext *)> *job;
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mNext >= mJobSize)
+                return;
+            index = mNext++;
+            job = mJob;
+        }
+        try {
+            (*job)(index, ctx);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (!mError)
+                mError = std::current_exception();
+        }
+    }
+}
+
+void LayoutPool::run(size_t count, const std::function<void(size_t, NVGcontext *)> &func) {
+    if (count == 0)
+        return;
+    if (count == 1) {
+        func(0, mContext);
+        return;
+    }
+    if (mWorkers.empty())
+        start();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJob = &func;
+        mJobSize = count;
+        mNext = 0;
+        mError = nullptr;
+        mGeneration++;
+    }
+    mJobCond.notify_all();
+
+    /* The calling thread takes part, also with a measurement context */
+    work(mCaller->ctx);
+
+    std::exception_ptr error;
+    {
+        /* Every index has been claimed; wait for the workers still busy with one */
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDoneCond.wait(lock, [&]() { return mBusy == 0; });
+        mJob = nullptr;
+        mJobSize = mNext = 0;
+        error = mError;
+        mError = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+NAMESPACE_END(nanogui)
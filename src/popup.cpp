@@ -13,6 +13,7 @@
 #include <nanogui/popup.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/shadowcache.h>
 
 NAMESPACE_BEGIN(nanogui)
     
@@ -72,16 +73,7 @@ void Popup::draw(NVGcontext* ctx) {
     int ds = mTheme->mWindowDropShadowSize, cr = mTheme->mWindowCornerRadius;
 
     /* Draw a drop shadow */
-    NVGpaint shadowPaint = nvgBoxGradient(
-        ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr*2, ds*2,
-        mTheme->mDropShadow, mTheme->mTransparent);
-
-    nvgBeginPath(ctx);
-    nvgRect(ctx, mPos.x-ds,mPos.y-ds, mSize.x+2*ds, mSize.y+2*ds);
-    nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr);
-    nvgPathWinding(ctx, NVG_HOLE);
-    nvgFillPaint(ctx, shadowPaint);
-    nvgFill(ctx);
+    nvgDropShadow(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr, ds, mTheme->mDropShadow);
 
     /* Draw window */
     nvgBeginPath(ctx);
@@ -0,0 +1,403 @@
+/*
+    src/primitivebatch.cpp -- Instanced signed-distance-field renderer
+    for the rounded rectangles that make up most widget chrome
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/primitivebatch.h>
+#include <nanogui/glutil.h>
+#include <cstring>
+#include <cmath>
+#include <map>
+
+NAMESPACE_BEGIN(nanogui)
+
+static const char *__batch_vertex_shader = R"(#version 330
+uniform vec2 viewSize;
+
+in vec2 corner;
+in vec4 rect;
+in vec4 shape;
+in vec4 hole;
+in vec4 xform;
+in vec4 translate;
+in vec4 paintXform;
+in vec4 paintExtent;
+in vec4 innerColor;
+in vec4 outerColor;
+in vec4 scissor;
+
+out vec2 localPos;
+out vec2 screenPos;
+flat out vec4 vRect;
+flat out vec4 vShape;
+flat out vec4 vHole;
+flat out vec4 vPaintXform;
+flat out vec4 vPaintExtent;
+flat out vec2 vPaintShape;
+flat out vec4 vInnerColor;
+flat out vec4 vOuterColor;
+flat out vec4 vScissor;
+
+void main() {
+    float margin = shape.w;
+    localPos = rect.xy - vec2(margin) + corner * (rect.zw + vec2(2.0 * margin));
+    screenPos = vec2(xform.x * localPos.x + xform.z * localPos.y + translate.x,
+                     xform.y * localPos.x + xform.w * localPos.y + translate.y);
+    vRect = rect;
+    vShape = shape;
+    vHole = hole;
+    vPaintXform = paintXform;
+    vPaintExtent = paintExtent;
+    vPaintShape = translate.zw;
+    vInnerColor = innerColor;
+    vOuterColor = outerColor;
+    vScissor = scissor;
+    gl_Position = vec4(2.0 * screenPos.x / viewSize.x - 1.0,
+                       1.0 - 2.0 * screenPos.y / viewSize.y, 0.0, 1.0);
+}
+)";
+
+static const char *__batch_fragment_shader = R"(#version 330
+in vec2 localPos;
+in vec2 screenPos;
+flat in vec4 vRect;
+flat in vec4 vShape;
+flat in vec4 vHole;
+flat in vec4 vPaintXform;
+flat in vec4 vPaintExtent;
+flat in vec2 vPaintShape;
+flat in vec4 vInnerColor;
+flat in vec4 vOuterColor;
+flat in vec4 vScissor;
+
+uniform sampler2D glyphAtlas;
+
+out vec4 color;
+
+/* Same distance function as the NanoVG GL backend */
+float sdroundrect(vec2 pt, vec2 ext, float rad) {
+    vec2 ext2 = ext - vec2(rad, rad);
+    vec2 d = abs(pt) - ext2;
+    return min(max(d.x, d.y), 0.0) + length(max(d, 0.0)) - rad;
+}
+
+float rectDistance(vec2 p, vec4 r, float rad) {
+    vec2 ext = 0.5 * r.zw;
+    return sdroundrect(p - r.xy - ext, ext, min(rad, min(ext.x, ext.y)));
+}
+
+void main() {
+    float aa = max(fwidth(localPos.x), 1e-4);
+    float d = rectDistance(localPos, vRect, vShape.x);
+
+    float coverage;
+    if (vShape.y < 0.0) {
+        /* Distance field glyph, 0.5 on the outline */
+        vec2 uv = mix(vHole.xy, vHole.zw, (localPos - vRect.xy) / vRect.zw);
+        float dist = texture(glyphAtlas, uv).r;
+        coverage = clamp((dist - 0.5) / max(fwidth(dist), 1e-4) + 0.5, 0.0, 1.0);
+    } else if (vShape.y > 0.0)
+        coverage = clamp((0.5 * vShape.y - abs(d)) / aa + 0.5, 0.0, 1.0);
+    else
+        coverage = clamp(0.5 - d / aa, 0.0, 1.0);
+
+    if (vShape.y >= 0.0 && vHole.z > 0.0)
+        coverage *= clamp(0.5 + rectDistance(localPos, vHole, vShape.z) / aa, 0.0, 1.0);
+
+    if (vScissor.z >= 0.0) {
+        vec2 ext = 0.5 * vScissor.zw;
+        vec2 sc = (ext - abs(screenPos - vScissor.xy - ext)) / max(fwidth(screenPos), vec2(1e-4));
+        coverage *= clamp(sc.x + 0.5, 0.0, 1.0) * clamp(sc.y + 0.5, 0.0, 1.0);
+    }
+
+    if (coverage <= 0.0)
+        discard;
+
+    /* Gradient evaluation as in NanoVG: distance to a box in paint space */
+    vec2 pt = vec2(vPaintXform.x * screenPos.x + vPaintXform.z * screenPos.y + vPaintExtent.x,
+                   vPaintXform.y * screenPos.x + vPaintXform.w * screenPos.y + vPaintExtent.y);
+    float feather = max(vPaintShape.y, 1e-4);
+    float t = clamp((sdroundrect(pt, vPaintExtent.zw, vPaintShape.x) + feather * 0.5) / feather, 0.0, 1.0);
+
+    color = mix(vInnerColor, vOuterColor, t) * coverage;
+}
+)";
+
+static std::map<NVGcontext *, std::unique_ptr<PrimitiveBatch>> __nanogui_batches;
+
+PrimitiveBatch &PrimitiveBatch::get(NVGcontext *ctx) {
+    auto &batch = __nanogui_batches[ctx];
+    if (!batch)
+        batch.reset(new PrimitiveBatch(ctx));
+    return *batch;
+}
+
+PrimitiveBatch *PrimitiveBatch::active(NVGcontext *ctx) {
+    auto it = __nanogui_batches.find(ctx);
+    if (it == __nanogui_batches.end() || !it->second->mActive)
+        return nullptr;
+    return it->second.get();
+}
+
+void PrimitiveBatch::release(NVGcontext *ctx) {
+    __nanogui_batches.erase(ctx);
+}
+
+PrimitiveBatch::PrimitiveBatch(NVGcontext *ctx)
+    : mContext(ctx), mShader(new GLShader()), mActive(false), mGlyphTexture(0) {
+    resetScissor();
+
+    /* Compiled in the background, NanoVG draws everything until it is ready */
+    mShader->initAsync("primitive_batch", __batch_vertex_shader, __batch_fragment_shader, "",
+        [this](bool success) {
+            if (!success)
+                return;
+            const float corners[] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+            mShader->bind();
+            mShader->uploadInterleaved("corners", VertexLayout().add<float>("corner", 2),
+                                       corners, 4);
+            /* A frame may flush several times (see Screen::drawWidgets());
+               orphaning never waits for the draws of earlier flushes */
+            mShader->setAttribUpdateMode("instances", BufferUpdate::Orphan);
+        });
+}
+
+PrimitiveBatch::~PrimitiveBatch() {
+    mShader->free();
+    delete mShader;
+}
+
+bool PrimitiveBatch::begin(const Vector2i &viewSize) {
+    mInstances.clear();
+    mScissorStack.clear();
+    resetScissor();
+    mViewSize = viewSize;
+    mActive = mShader->ready();
+    return mActive;
+}
+
+void PrimitiveBatch::flush() {
+    if (mInstances.empty())
+        return;
+
+    static const VertexLayout layout = VertexLayout()
+        .add<float>("rect", 4).add<float>("shape", 4).add<float>("hole", 4)
+        .add<float>("xform", 4).add<float>("translate", 4)
+        .add<float>("paintXform", 4).add<float>("paintExtent", 4)
+        .add<float>("innerColor", 4).add<float>("outerColor", 4)
+        .add<float>("scissor", 4).setDivisor(1);
+
+    glEnable(GL_BLEND);
+    glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_STENCIL_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    mShader->bind();
+    mShader->setUniform("viewSize", Vector2f(mViewSize));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, mGlyphTexture);
+    mShader->setUniform("glyphAtlas", 0);
+    mShader->uploadInterleaved("instances", layout, mInstances);
+    mShader->drawArrayInstanced(GL_TRIANGLE_STRIP, 0, 4, (uint32_t) mInstances.size());
+    glBindVertexArray(0);
+
+    mInstances.clear();
+}
+
+void PrimitiveBatch::end() {
+    flush();
+    mActive = false;
+}
+
+PrimitiveBatch::Instance &PrimitiveBatch::push(NVGcontext *ctx, float x, float y, float w,
+                                               float h, float r, const NVGpaint &paint,
+                                               float margin) {
+    mInstances.emplace_back();
+    Instance &inst = mInstances.back();
+
+    float xform[6], paintXform[6], inverse[6];
+    nvgCurrentTransform(ctx, xform);
+
+    /* Like nvgFillPaint(): the paint lives in the current coordinate system */
+    memcpy(paintXform, paint.xform, sizeof(paintXform));
+    nvgTransformMultiply(paintXform, xform);
+    nvgTransformInverse(inverse, paintXform);
+
+    float data[10][4] = {
+        { x, y, w, h },
+        { r, 0.f, 0.f, margin },
+        { 0.f, 0.f, 0.f, 0.f },
+        { xform[0], xform[1], xform[2], xform[3] },
+        { xform[4], xform[5], paint.radius, paint.feather },
+        { inverse[0], inverse[1], inverse[2], inverse[3] },
+        { inverse[4], inverse[5], paint.extent[0], paint.extent[1] },
+        { paint.innerColor.r * paint.innerColor.a, paint.innerColor.g * paint.innerColor.a,
+          paint.innerColor.b * paint.innerColor.a, paint.innerColor.a },
+        { paint.outerColor.r * paint.outerColor.a, paint.outerColor.g * paint.outerColor.a,
+          paint.outerColor.b * paint.outerColor.a, paint.outerColor.a },
+        { mScissor.x, mScissor.y, mScissor.z, mScissor.w }
+    };
+    static_assert(sizeof(data) == sizeof(Instance), "Instance layout mismatch");
+    memcpy(&inst, data, sizeof(Instance));
+    return inst;
+}
+
+void PrimitiveBatch::fill(NVGcontext *ctx, float x, float y, float w, float h, float r,
+                          const NVGpaint &paint) {
+    push(ctx, x, y, w, h, r, paint, 1.f);
+}
+
+void PrimitiveBatch::stroke(NVGcontext *ctx, float x, float y, float w, float h, float r,
+                            const NVGpaint &paint, float width) {
+    Instance &inst = push(ctx, x, y, w, h, r, paint, 1.f + width * 0.5f);
+    inst.shape[1] = width;
+}
+
+void PrimitiveBatch::fillWithHole(NVGcontext *ctx, float x, float y, float w, float h,
+                                  float hx, float hy, float hw, float hh, float hr,
+                                  const NVGpaint &paint) {
+    Instance &inst = push(ctx, x, y, w, h, 0.f, paint, 1.f);
+    inst.shape[2] = hr;
+    inst.hole[0] = hx; inst.hole[1] = hy;
+    inst.hole[2] = hw; inst.hole[3] = hh;
+}
+
+void PrimitiveBatch::scissor(NVGcontext *ctx, float x, float y, float w, float h) {
+    /* Widgets only translate, so the transformed rectangle stays axis-aligned */
+    float xform[6];
+    nvgCurrentTransform(ctx, xform);
+    float sx = std::sqrt(xform[0] * xform[0] + xform[2] * xform[2]);
+    float sy = std::sqrt(xform[1] * xform[1] + xform[3] * xform[3]);
+    mScissor = Vector4f(xform[0] * x + xform[2] * y + xform[4],
+                        xform[1] * x + xform[3] * y + xform[5],
+                        std::max(w, 0.f) * sx, std::max(h, 0.f) * sy);
+}
+
+void PrimitiveBatch::restore() {
+    if (mScissorStack.empty())
+        return;
+    mScissor = mScissorStack.back();
+    mScissorStack.pop_back();
+}
+
+static NVGpaint colorPaint(const NVGcolor &color) {
+    NVGpaint paint;
+    memset(&paint, 0, sizeof(paint));
+    nvgTransformIdentity(paint.xform);
+    paint.radius = 0.f;
+    paint.feather = 1.f;
+    paint.innerColor = paint.outerColor = color;
+    return paint;
+}
+
+void PrimitiveBatch::glyph(NVGcontext *ctx, float x, float y, float w, float h,
+                           const float uv[4], const NVGcolor &color, uint32_t texture) {
+    if (texture != mGlyphTexture) {
+        flush();
+        mGlyphTexture = texture;
+    }
+    Instance &inst = push(ctx, x, y, w, h, 0.f, colorPaint(color), 0.f);
+    inst.shape[1] = -1.f;
+    memcpy(inst.hole, uv, sizeof(inst.hole));
+}
+
+void nvgBatchFillRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                             float r, const NVGpaint &paint) {
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx)) {
+        batch->fill(ctx, x, y, w, h, r, paint);
+        return;
+    }
+    nvgBeginPath(ctx);
+    nvgRoundedRect(ctx, x, y, w, h, r);
+    nvgFillPaint(ctx, paint);
+    nvgFill(ctx);
+}
+
+void nvgBatchFillRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                             float r, const NVGcolor &color) {
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx)) {
+        batch->fill(ctx, x, y, w, h, r, colorPaint(color));
+        return;
+    }
+    nvgBeginPath(ctx);
+    nvgRoundedRect(ctx, x, y, w, h, r);
+    nvgFillColor(ctx, color);
+    nvgFill(ctx);
+}
+
+void nvgBatchStrokeRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                               float r, const NVGpaint &paint, float width) {
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx)) {
+        batch->stroke(ctx, x, y, w, h, r, paint, width);
+        return;
+    }
+    nvgBeginPath(ctx);
+    nvgRoundedRect(ctx, x, y, w, h, r);
+    nvgStrokeWidth(ctx, width);
+    nvgStrokePaint(ctx, paint);
+    nvgStroke(ctx);
+}
+
+void nvgBatchStrokeRoundedRect(NVGcontext *ctx, float x, float y, float w, float h,
+                               float r, const NVGcolor &color, float width) {
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx)) {
+        batch->stroke(ctx, x, y, w, h, r, colorPaint(color), width);
+        return;
+    }
+    nvgBeginPath(ctx);
+    nvgRoundedRect(ctx, x, y, w, h, r);
+    nvgStrokeWidth(ctx, width);
+    nvgStrokeColor(ctx, color);
+    nvgStroke(ctx);
+}
+
+void nvgBatchFillRoundedRectHole(NVGcontext *ctx, float x, float y, float w, float h,
+                                 float hx, float hy, float hw, float hh, float hr,
+                                 const NVGpaint &paint) {
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx)) {
+        batch->fillWithHole(ctx, x, y, w, h, hx, hy, hw, hh, hr, paint);
+        return;
+    }
+    nvgBeginPath(ctx);
+    nvgRect(ctx, x, y, w, h);
+    nvgRoundedRect(ctx, hx, hy, hw, hh, hr);
+    nvgPathWinding(ctx, NVG_HOLE);
+    nvgFillPaint(ctx, paint);
+    nvgFill(ctx);
+}
+
+void nvgBatchScissor(NVGcontext *ctx, float x, float y, float w, float h) {
+    nvgScissor(ctx, x, y, w, h);
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx))
+        batch->scissor(ctx, x, y, w, h);
+}
+
+void nvgBatchResetScissor(NVGcontext *ctx) {
+    nvgResetScissor(ctx);
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx))
+        batch->resetScissor();
+}
+
+void nvgBatchSave(NVGcontext *ctx) {
+    nvgSave(ctx);
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx))
+        batch->save();
+}
+
+void nvgBatchRestore(NVGcontext *ctx) {
+    nvgRestore(ctx);
+    if (PrimitiveBatch *batch = PrimitiveBatch::active(ctx))
+        batch->restore();
+}
+
+NAMESPACE_END(nanogui)
@@ -11,11 +11,28 @@
 
 #include <nanogui/progressbar.h>
 #include <nanogui/opengl.h>
+#include <nanogui/primitivebatch.h>
 
 NAMESPACE_BEGIN(nanogui)
 
 ProgressBar::ProgressBar(ref<Widget> parent)
-    : Widget(parent), mValue(0.0f) {}
+    : Widget(parent), mValue(0.0f), mDrawnValue(0.0f) {}
+
+void ProgressBar::bind(const std::atomic<float> &source) {
+    unbind();
+    mSource = &source;
+    mDrawnValue.store(mValue, std::memory_order_relaxed);
+    const std::atomic<float> *src = mSource;
+    std::atomic<float> *drawn = &mDrawnValue;
+    mWatch.reset(new TelemetryWatch([src, drawn]() {
+        return src->load(std::memory_order_relaxed) != drawn->load(std::memory_order_relaxed);
+    }));
+}
+
+void ProgressBar::unbind() {
+    mWatch.reset();
+    mSource = nullptr;
+}
 
 Vector2i ProgressBar::preferredSize(NVGcontext *) {
     return Vector2i(70, 12);
@@ -24,13 +41,16 @@ Vector2i ProgressBar::preferredSize(NVGcontext *) {
 void ProgressBar::draw(NVGcontext* ctx) {
     Widget::draw(ctx);
 
+    if (mSource) {
+        mValue = mSource->load(std::memory_order_relaxed);
+        mDrawnValue.store(mValue, std::memory_order_relaxed);
+        mWatch->rearm();
+    }
+
     NVGpaint paint = nvgBoxGradient(
         ctx, mPos.x + 1, mPos.y + 1,
         mSize.x-2, mSize.y, 3, 4, Color(0, 32), Color(0, 92));
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, 3);
-    nvgFillPaint(ctx, paint);
-    nvgFill(ctx);
+    nvgBatchFillRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, 3, paint);
 
     float value = std::min(std::max(0.0f, mValue), 1.0f);
     int barPos = (int) std::round((mSize.x - 2) * value);
@@ -40,12 +60,7 @@ void ProgressBar::draw(NVGcontext* ctx) {
         barPos+1.5f, mSize.y-1, 3, 4,
         Color(220, 100), Color(128, 100));
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(
-        ctx, mPos.x+1, mPos.y+1,
-        barPos, mSize.y-2, 3);
-    nvgFillPaint(ctx, paint);
-    nvgFill(ctx);
+    nvgBatchFillRoundedRect(ctx, mPos.x+1, mPos.y+1, barPos, mSize.y-2, 3, paint);
 }
 
 NAMESPACE_END(nanogui)
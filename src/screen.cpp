@@ -16,17 +16,51 @@
 #include <nanogui/opengl.h>
 #include <nanogui/window.h>
 #include <nanogui/popup.h>
+#include <nanogui/glutil.h>
+#include <nanogui/glyphcache.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/layoutpool.h>
+#include <nanogui/primitivebatch.h>
+#include <nanogui/sdftext.h>
+#include <nanogui/shadowcache.h>
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <cstring>
 
 /* Allow enforcing the GL2 implementation of NanoVG */
 #define NANOVG_GL3_IMPLEMENTATION
 #include <nanovg_gl.h>
 
+/* Content scale queries and callbacks were added in GLFW 3.3 */
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 3)
+#  define NANOGUI_GLFW_CONTENT_SCALE
+#endif
+
 NAMESPACE_BEGIN(nanogui)
 
+/* Seconds per frame spent rasterizing glyphs declared in the GlyphCache */
+static const double __glyph_prewarm_budget = 0.004;
+
+/* Seconds per frame spent on tasks from Screen::post() */
+static const double __task_budget = 0.005;
+
+/* Frame rates of unfocused screens with PowerPolicy::Balanced and ::Saver */
+static const float __background_fps = 10.f;
+static const float __background_fps_saver = 2.f;
+
+/* Seconds after the last input during which a screen is drawn at full rate */
+static const double __interaction_grace = 1.0;
+
 std::map<GLFWwindow *, Screen *> __nanogui_screens;
 
+/* glfwGetCurrentContext() only reads a thread-local variable, whereas making
+   a context current again may still reach the windowing system */
+static void make_current_helper(GLFWwindow *window) {
+    if (glfwGetCurrentContext() != window)
+        glfwMakeContextCurrent(window);
+}
+
 Screen::Screen()
     : Widget(nullptr), mGLFWWindow(nullptr), mNVGContext(nullptr),
       mCursor(Cursor::Arrow), mShutdownGLFWOnDestruct(false) {
@@ -34,7 +68,7 @@ Screen::Screen()
 }
 
 Screen::Screen(const Vector2i &size, const std::string &caption,
-               bool resizable, bool fullscreen)
+               bool resizable, bool fullscreen, Screen *share)
     : Widget(nullptr), mGLFWWindow(nullptr), mNVGContext(nullptr),
       mCursor(Cursor::Arrow), mCaption(caption), mShutdownGLFWOnDestruct(false) {
     memset(mCursors, 0, sizeof(GLFWcursor *) * (int) Cursor::CursorCount);
@@ -60,10 +94,11 @@ Screen::Screen(const Vector2i &size, const std::string &caption,
         GLFWmonitor *monitor = glfwGetPrimaryMonitor();
         const GLFWvidmode *mode = glfwGetVideoMode(monitor);
         mGLFWWindow = glfwCreateWindow(mode->width, mode->height,
-                                       caption.c_str(), monitor, nullptr);
+                                       caption.c_str(), monitor,
+                                       share ? share->mGLFWWindow : nullptr);
     } else {
         mGLFWWindow = glfwCreateWindow(size.x, size.y, caption.c_str(),
-                                       nullptr, nullptr);
+                                       nullptr, share ? share->mGLFWWindow : nullptr);
     }
 
     if (!mGLFWWindow)
@@ -87,105 +122,163 @@ Screen::Screen(const Vector2i &size, const std::string &caption,
     glfwPollEvents();
 #endif
 
-    /* Propagate GLFW events to the appropriate Screen instance */
+    /* Propagate GLFW events to the appropriate Screen instance (set as the
+       window user pointer once initialized), which queues them */
     glfwSetCursorPosCallback(mGLFWWindow,
         [](GLFWwindow *w, double x, double y) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
-                return;
-            Screen* s = it->second;
-            if (!s->mProcessEvents)
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-            s->cursorPosCallbackEvent(x, y);
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::CursorPos;
+            e.x = x; e.y = y;
+            s->queueEvent(e);
         }
     );
 
     glfwSetMouseButtonCallback(mGLFWWindow,
         [](GLFWwindow *w, int button, int action, int modifiers) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
-                return;
-			Screen* s = it->second;
-            if (!s->mProcessEvents)
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-            s->mouseButtonCallbackEvent(button, action, modifiers);
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::MouseButton;
+            e.button = button; e.action = action; e.modifiers = modifiers;
+            s->queueEvent(e);
         }
     );
 
     glfwSetKeyCallback(mGLFWWindow,
         [](GLFWwindow *w, int key, int scancode, int action, int mods) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-			Screen* s = it->second;
-            if (!s->mProcessEvents)
-                return;
-            s->keyCallbackEvent(key, scancode, action, mods);
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::Key;
+            e.key = key; e.scancode = scancode; e.action = action; e.modifiers = mods;
+            s->queueEvent(e);
         }
     );
 
     glfwSetCharCallback(mGLFWWindow,
         [](GLFWwindow *w, unsigned int codepoint) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
-                return;
-			Screen* s = it->second;
-            if (!s->mProcessEvents)
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-            s->charCallbackEvent(codepoint);
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::Char;
+            e.codepoint = codepoint;
+            s->queueEvent(e);
         }
     );
 
     glfwSetDropCallback(mGLFWWindow,
         [](GLFWwindow *w, int count, const char **filenames) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
-                return;
-			Screen* s = it->second;
-            if (!s->mProcessEvents)
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-            s->dropCallbackEvent(count, filenames);
+            /* The file names are only valid during the callback */
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::Drop;
+            e.filenames.assign(filenames, filenames + count);
+            s->queueEvent(e);
         }
     );
 
     glfwSetScrollCallback(mGLFWWindow,
         [](GLFWwindow *w, double x, double y) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s || !s->mProcessEvents)
                 return;
-			Screen* s = it->second;
-            if (!s->mProcessEvents)
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::Scroll;
+            e.x = x; e.y = y;
+            s->queueEvent(e);
+        }
+    );
+
+    /* Iconified and unfocused screens are drawn less often by mainloop() */
+    glfwSetWindowIconifyCallback(mGLFWWindow,
+        [](GLFWwindow *w, int iconified) {
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (s)
+                s->iconifyCallbackEvent(iconified != 0);
+        }
+    );
+
+    glfwSetWindowFocusCallback(mGLFWWindow,
+        [](GLFWwindow *w, int focused) {
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (s)
+                s->focusCallbackEvent(focused != 0);
+        }
+    );
+
+    /* Keep track of the window metrics, so that setting up a frame does
+       not need to query the windowing system (a round trip on X11) */
+    glfwSetWindowSizeCallback(mGLFWWindow,
+        [](GLFWwindow *w, int width, int height) {
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s)
                 return;
-            s->scrollCallbackEvent(x, y);
+            std::lock_guard<std::recursive_mutex> guard(s->mUILock);
+            s->mWindowSize = Vector2i(width, height);
+            s->updateSize();
         }
     );
 
+#if defined(NANOGUI_GLFW_CONTENT_SCALE)
+    glfwSetWindowContentScaleCallback(mGLFWWindow,
+        [](GLFWwindow *w, float x, float y) {
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s)
+                return;
+            std::lock_guard<std::recursive_mutex> guard(s->mUILock);
+            s->mContentScale = Vector2f(x, y);
+            glfwPostEmptyEvent();
+        }
+    );
+#endif
+
     /* React to framebuffer size events -- includes window
        size events and also catches things like dragging
        a window from a Retina-capable screen to a normal
        screen on Mac OS X */
     glfwSetFramebufferSizeCallback(mGLFWWindow,
         [](GLFWwindow* w, int width, int height) {
-            auto it = __nanogui_screens.find(w);
-            if (it == __nanogui_screens.end())
+            Screen *s = (Screen *) glfwGetWindowUserPointer(w);
+            if (!s)
                 return;
-			Screen* s = it->second;
-
+            {
+                std::lock_guard<std::recursive_mutex> guard(s->mUILock);
+                s->mFBSize = Vector2i(width, height);
+                s->updateSize();
+            }
             if (!s->mProcessEvents)
                 return;
-
-            s->resizeCallbackEvent(width, height);
+            InputEvent e;
+            e.time = glfwGetTime();
+            e.type = InputEvent::Type::Resize;
+            e.x = width; e.y = height;
+            s->queueEvent(e);
         }
     );
 
-    initialize(mGLFWWindow, true);
+    initialize(mGLFWWindow, true, share);
+    glfwSetWindowUserPointer(mGLFWWindow, this);
+    mTrackMetrics = true;
 }
 
-void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct) {
+void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct, Screen *share) {
     mGLFWWindow = window;
     mShutdownGLFWOnDestruct = shutdownGLFWOnDestruct;
-    glfwGetWindowSize(mGLFWWindow, &mSize[0], &mSize[1]);
-    glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
+    queryMetrics();
 
 #ifdef NDEBUG
     mNVGContext = nvgCreateGL3(NVG_STENCIL_STROKES | NVG_ANTIALIAS);
@@ -196,7 +289,15 @@ void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct) {
         throw std::runtime_error("Could not initialize NanoVG!");
 
     mVisible = glfwGetWindowAttrib(window, GLFW_VISIBLE) != 0;
-    mTheme = makeref<Theme>(mNVGContext);
+    mIconified = glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0;
+    mWindowFocused = glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0;
+    if (share) {
+        mTheme = share->mTheme;
+        mTheme->registerFonts(mNVGContext);
+        ImageAtlas::share(mNVGContext, share->mNVGContext);
+    } else {
+        mTheme = makeref<Theme>(mNVGContext);
+    }
     mMousePos = Vector2i(0);
     mMouseState = mModifiers = 0;
     mDragActive = false;
@@ -211,13 +312,30 @@ void Screen::initialize(GLFWwindow *window, bool shutdownGLFWOnDestruct) {
 }
 
 Screen::~Screen() {
+    setThreadedRendering(false);
+    syncRenderThread();
     __nanogui_screens.erase(mGLFWWindow);
+    if (mGLFWWindow && glfwGetWindowUserPointer(mGLFWWindow) == this)
+        glfwSetWindowUserPointer(mGLFWWindow, nullptr);
+    if (mGLFWWindow) {
+        glfwMakeContextCurrent(mGLFWWindow);
+        GLReadback::clear();
+        mFramebufferPool.reset();
+        GLShader::release(mGLFWWindow);
+    }
     for (int i=0; i < (int) Cursor::CursorCount; ++i) {
         if (mCursors[i])
             glfwDestroyCursor(mCursors[i]);
     }
-    if (mNVGContext)
+    if (mNVGContext) {
+        LayoutPool::release(mNVGContext);
+        ImageAtlas::release(mNVGContext);
+        PrimitiveBatch::release(mNVGContext);
+        ShadowCache::release(mNVGContext);
+        GlyphCache::release(mNVGContext);
+        SDFText::release(mNVGContext);
         nvgDeleteGL3(mNVGContext);
+    }
     if (mGLFWWindow && mShutdownGLFWOnDestruct)
         glfwDestroyWindow(mGLFWWindow);
 }
@@ -242,33 +360,408 @@ void Screen::setCaption(const std::string &caption) {
 
 void Screen::setSize(const Vector2i &size) {
     Widget::setSize(size);
-    glfwSetWindowSize(mGLFWWindow, size.x, size.y);
+    glfwSetWindowSize(mGLFWWindow, (int) (size.x * mUIScale), (int) (size.y * mUIScale));
+}
+
+void Screen::queryMetrics() {
+    glfwGetWindowSize(mGLFWWindow, &mWindowSize[0], &mWindowSize[1]);
+    glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
+#if defined(NANOGUI_GLFW_CONTENT_SCALE)
+    glfwGetWindowContentScale(mGLFWWindow, &mContentScale[0], &mContentScale[1]);
+#endif
+    updateSize();
+}
+
+void Screen::updateSize() {
+    mSize = Vector2i(Vector2f(mWindowSize) / mUIScale);
+
+    /* Framebuffer pixels per logical unit: hi-dpi ratio times the UI scale */
+    mPixelRatio = mWindowSize[0] > 0 ? (float) mFBSize[0] / (float) mWindowSize[0] * mUIScale
+                                     : mUIScale;
+}
+
+void Screen::setUIScale(float scale) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
+    if (scale <= 0.f || scale == mUIScale)
+        return;
+
+    /* Remember the placement of the top-level widgets at the current scale */
+    auto &saved = mScalePlacements[mUIScale];
+    saved.clear();
+    for (auto child : mChildren) {
+        Vector2i pos = child->position(), size = child->size();
+        saved.emplace_back(child, Vector4i(pos.x, pos.y, size.x, size.y));
+    }
+
+    mUIScale = scale;
+    updateSize();
+
+    auto it = mScalePlacements.find(scale);
+    if (it != mScalePlacements.end()) {
+        for (auto const &entry : it->second) {
+            ref<Widget> widget = entry.first.lock();
+            if (!widget || widget->parent().get() != this)
+                continue;
+            widget->setPosition(Vector2i(entry.second.x, entry.second.y));
+            Vector2i size(entry.second.z, entry.second.w);
+            if (widget->size() != size) {
+                widget->setSize(size);
+                widget->performLayout(mNVGContext);
+            }
+        }
+    } else {
+        /* First visit of this scale: only keep the windows on screen */
+        for (auto child : mChildren) {
+            if (!dynamic_pointer_cast<Window>(child))
+                continue;
+            Vector2i pos = glm::max(glm::min(child->position(), mSize - child->size()),
+                                    Vector2i(0));
+            child->setPosition(pos);
+        }
+    }
+
+    mLastInteraction = glfwGetTime();
+    resizeEvent(mSize);
+    glfwPostEmptyEvent();
+}
+
+void Screen::post(std::function<void()> task) {
+    mTasks.push(std::move(task));
+    glfwPostEmptyEvent();
+}
+
+void Screen::runPending() {
+    /* Must happen before taking the lock, see setThreadedRendering() */
+    syncRenderThread();
+
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
+
+    /* Input which arrived since the last frame, merged */
+    dispatchEvents();
+
+    /* Posted tasks get a slice of every frame, the rest waits for the next one */
+    mTasks.run(__task_budget);
+    if (!mTasks.empty())
+        glfwPostEmptyEvent();
+}
+
+double Screen::frameDelay() const {
+    if (mIconified)
+        return -1;
+
+    float fps = mBackgroundFrameRate;
+    if (fps <= 0) {
+        switch (powerPolicy()) {
+            case PowerPolicy::Performance: fps = 0.f; break;
+            case PowerPolicy::Balanced: fps = __background_fps; break;
+            case PowerPolicy::Saver: fps = __background_fps_saver; break;
+        }
+    }
+
+    double now = glfwGetTime();
+    if (fps <= 0 || mWindowFocused || now - mLastInteraction < __interaction_grace)
+        return 0;
+    return std::max(0.0, mLastFrameTime + 1.0 / fps - now);
 }
 
 void Screen::drawAll() {
+    mLastFrameTime = glfwGetTime();
+    runPending();
+
+    if (mThreadedRendering) {
+        {
+            std::lock_guard<std::recursive_mutex> guard(mUILock);
+            updateSize();
+        }
+
+        /* Requests made while a frame is in flight collapse into one */
+        {
+            std::lock_guard<std::mutex> guard(mFrameMutex);
+            mFrameRequested = true;
+        }
+        mFrameCond.notify_one();
+        return;
+    }
+
+    make_current_helper(mGLFWWindow);
+    renderFrame();
+    glfwSwapBuffers(mGLFWWindow);
+
+    if (mFramebufferPool)
+        mFramebufferPool->collect();
+}
+
+void Screen::renderFrame() {
+    GLShader::processPending();
+    GLReadback::process();
+
     glClearColor(mBackground[0], mBackground[1], mBackground[2], 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     drawContents();
     drawWidgets();
 
-    glfwSwapBuffers(mGLFWWindow);
+    if (!mFrameCaptures.empty()) {
+        std::vector<FrameCallback> callbacks;
+        callbacks.swap(mFrameCaptures);
+        Vector2i size = mFBSize;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        GLReadback::readPixels(Vector2i(0, 0), size,
+            [callbacks, size](const uint8_t *data, size_t bytes) {
+                /* Flip the rows into the usual top-down image order */
+                std::vector<uint8_t> flipped(bytes);
+                size_t stride = (size_t) size.x * 4;
+                for (int y = 0; y < size.y; ++y)
+                    memcpy(&flipped[(size_t) y * stride],
+                           data + (size_t) (size.y - 1 - y) * stride, stride);
+                for (auto const &callback : callbacks)
+                    callback(size, flipped.data());
+            });
+    }
+}
+
+void Screen::setThreadedRendering(bool enabled) {
+    mRenderThreadWanted = enabled;
+
+    if (enabled && !mThreadedRendering) {
+        /* The context can only be current on one thread at a time */
+        glfwMakeContextCurrent(nullptr);
+        mStopRender = false;
+        mThreadedRendering = true;
+        mRenderThread = std::thread([this]() { renderLoop(); });
+    } else if (!enabled && mThreadedRendering && !mStopRender) {
+        /* The caller may hold the UI lock, which the render thread might be
+           waiting for: only ask it to stop here, syncRenderThread() joins it */
+        {
+            std::lock_guard<std::mutex> guard(mFrameMutex);
+            mStopRender = true;
+        }
+        mFrameCond.notify_one();
+        glfwPostEmptyEvent();
+    }
+}
+
+void Screen::syncRenderThread() {
+    if (!mThreadedRendering || !mStopRender)
+        return;
+    mRenderThread.join();
+    mThreadedRendering = false;
+    glfwMakeContextCurrent(mGLFWWindow);
+
+    /* Re-enabled while the stop was pending */
+    if (mRenderThreadWanted)
+        setThreadedRendering(true);
+}
+
+void Screen::renderLoop() {
+    glfwMakeContextCurrent(mGLFWWindow);
+
+    std::unique_lock<std::mutex> lock(mFrameMutex);
+    while (true) {
+        mFrameCond.wait(lock, [this]() { return mFrameRequested || mStopRender; });
+        if (mStopRender)
+            break;
+        mFrameRequested = false;
+        lock.unlock();
+
+        {
+            std::lock_guard<std::recursive_mutex> guard(mUILock);
+            renderFrame();
+        }
+
+        /* Waits for vsync without holding up the event thread */
+        glfwSwapBuffers(mGLFWWindow);
+
+        if (mFramebufferPool)
+            mFramebufferPool->collect();
+
+        lock.lock();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+GLFramebufferPool &Screen::framebufferPool() {
+    if (!mFramebufferPool)
+        mFramebufferPool.reset(new GLFramebufferPool());
+    return *mFramebufferPool;
+}
+
+void Screen::setSDFText(bool enabled) {
+    SDFText::get(mNVGContext).setEnabled(enabled);
+}
+
+bool Screen::sdfText() const {
+    SDFText *sdf = SDFText::find(mNVGContext);
+    return sdf && sdf->enabled();
+}
+
+int Screen::createFont(const std::string &name, const std::string &filename) {
+    int font = nvgCreateFont(mNVGContext, name.c_str(), filename.c_str());
+    if (font == -1)
+        throw std::runtime_error("Could not load font \"" + filename + "\"!");
+    LayoutPool::get(mNVGContext).addFontFile(name, filename);
+    return font;
+}
+
+int Screen::createFontMem(const std::string &name, const uint8_t *data, size_t size) {
+    int font = nvgCreateFontMem(mNVGContext, name.c_str(), const_cast<uint8_t *>(data),
+                                (int) size, 0);
+    if (font == -1)
+        throw std::runtime_error("Could not load font \"" + name + "\"!");
+    LayoutPool::get(mNVGContext).addFont(name, data, size);
+    return font;
+}
+
+void Screen::performLayout() {
+    if (!mParallelLayout || mLayout || mChildren.size() < 2) {
+        Widget::performLayout(mNVGContext);
+        return;
+    }
+
+    /* Same as Widget::performLayout(), but with one task per window. The
+       subtrees are disjoint, so the workers only write geometry of their
+       own widgets; it is visible here once run() has returned. */
+    LayoutPool::get(mNVGContext).run(mChildren.size(), [&](size_t i, NVGcontext *ctx) {
+        Widget *c = mChildren[i].get();
+        Vector2i pref = c->preferredSize(ctx), fix = c->fixedSize();
+        c->setSize(Vector2i(
+            fix[0] ? fix[0] : pref[0],
+            fix[1] ? fix[1] : pref[1]
+        ));
+        c->performLayout(ctx);
+    });
+}
+
+void Screen::captureFrameAsync(const FrameCallback &callback) {
+    {
+        /* Consumed by renderFrame(), possibly on the render thread */
+        std::lock_guard<std::recursive_mutex> guard(mUILock);
+        mFrameCaptures.push_back(callback);
+    }
+    glfwPostEmptyEvent();
+}
+
+/* Return whether the rectangle (x0, y0, x1, y1) lies within the union of the occluders */
+static bool covered_helper(const Vector4i &rect, const std::vector<Vector4i> &occluders) {
+    std::vector<Vector4i> remaining { rect }, next;
+
+    for (auto const &o : occluders) {
+        next.clear();
+        for (auto const &r : remaining) {
+            if (o.x >= r.z || o.z <= r.x || o.y >= r.w || o.w <= r.y) {
+                next.push_back(r);
+                continue;
+            }
+            /* Keep the parts of 'r' outside of 'o': above, below, left, right */
+            int y0 = std::max(r.y, o.y), y1 = std::min(r.w, o.w);
+            if (r.y < o.y) next.push_back(Vector4i(r.x, r.y, r.z, o.y));
+            if (r.w > o.w) next.push_back(Vector4i(r.x, o.w, r.z, r.w));
+            if (r.x < o.x) next.push_back(Vector4i(r.x, y0, o.x, y1));
+            if (r.z > o.z) next.push_back(Vector4i(o.z, y0, r.z, y1));
+        }
+        remaining.swap(next);
+        if (remaining.empty())
+            return true;
+        if (remaining.size() > 64)
+            return false; /* Too fragmented to be worth it, just draw */
+    }
+    return false;
+}
+
+void Screen::collectDrawList(std::vector<Widget *> &drawList) {
+    drawList.clear();
+    std::vector<Vector4i> occluders;
+    int ds = mTheme ? mTheme->mWindowDropShadowSize : 0;
+
+    /* Walk from the front-most window to the back */
+    for (auto it = mChildren.rbegin(); it != mChildren.rend(); ++it) {
+        Widget *child = it->get();
+        if (!child->visible())
+            continue;
+
+        Window *window = dynamic_cast<Window *>(child);
+        if (mOcclusionCulling && window && !dynamic_cast<Popup *>(window)) {
+            Vector2i pos = child->position(), size = child->size();
+            if (covered_helper(Vector4i(pos.x - ds, pos.y - ds,
+                                        pos.x + size.x + ds, pos.y + size.y + ds),
+                               occluders))
+                continue; /* Hidden together with its whole subtree */
+
+            if (window->opaqueRegion(pos, size))
+                occluders.push_back(Vector4i(pos.x, pos.y, pos.x + size.x, pos.y + size.y));
+        }
+        drawList.push_back(child);
+    }
+    std::reverse(drawList.begin(), drawList.end());
 }
 
 void Screen::drawWidgets() {
     if (!mVisible)
         return;
 
-    glfwMakeContextCurrent(mGLFWWindow);
-    glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
-    glfwGetWindowSize(mGLFWWindow, &mSize[0], &mSize[1]);
+    if (!mThreadedRendering) {
+        /* The event thread updates the size when a render thread is used */
+        make_current_helper(mGLFWWindow);
+        updateSize();
+    }
     glViewport(0, 0, mFBSize[0], mFBSize[1]);
 
-    /* Calculate pixel ratio for hi-dpi devices. */
-    mPixelRatio = (float) mFBSize[0] / (float) mSize[0];
+    /* A shared atlas is uploaded and repacked by the screen owning it */
+    ImageAtlas *atlas = ImageAtlas::find(mNVGContext);
+    if (atlas && atlas->context() == mNVGContext)
+        atlas->update();
+
     nvgBeginFrame(mNVGContext, mSize[0], mSize[1], mPixelRatio);
 
-    draw(mNVGContext);
+    /* Rasterize declared glyphs a few milliseconds per frame until done */
+    if (GlyphCache *glyphs = GlyphCache::find(mNVGContext)) {
+        if (glyphs->pending()) {
+            glyphs->prewarm(mPixelRatio, __glyph_prewarm_budget);
+            if (glyphs->pending())
+                glfwPostEmptyEvent();
+        }
+    }
+
+    PrimitiveBatch *batch = nullptr;
+    if (mBatchedPrimitives) {
+        batch = &PrimitiveBatch::get(mNVGContext);
+        if (!batch->begin(mSize))
+            batch = nullptr;
+    }
+
+    collectDrawList(mDrawList);
+
+    if (batch) {
+        /* Batched shapes go underneath the NanoVG content drawn with them.
+           Flush both only before a window that overlaps one drawn since the
+           last flush, so that it covers their content */
+        int ds = mTheme ? mTheme->mWindowDropShadowSize : 0;
+        std::vector<Vector4i> drawn;
+        for (auto child : mDrawList) {
+            Vector2i pos = child->position(), size = child->size();
+            Vector4i bounds(pos.x - ds, pos.y - ds, pos.x + size.x + ds, pos.y + size.y + ds);
+            for (auto const &d : drawn) {
+                if (bounds.x < d.z && d.x < bounds.z && bounds.y < d.w && d.y < bounds.w) {
+                    batch->flush();
+                    nvgEndFrame(mNVGContext);
+                    nvgBeginFrame(mNVGContext, mSize[0], mSize[1], mPixelRatio);
+                    drawn.clear();
+                    break;
+                }
+            }
+            drawn.push_back(bounds);
+            child->draw(mNVGContext);
+        }
+        batch->end();
+    } else {
+        nvgTranslate(mNVGContext, mPos.x, mPos.y);
+        for (auto child : mDrawList)
+            child->draw(mNVGContext);
+        nvgTranslate(mNVGContext, -mPos.x, -mPos.y);
+    }
+    mDrawList.clear();
 
     double elapsed = glfwGetTime() - mLastInteraction;
 
@@ -279,15 +772,12 @@ void Screen::drawWidgets() {
             int tooltipWidth = 150;
 
             float bounds[4];
-            nvgFontFace(mNVGContext, "sans");
-            nvgFontSize(mNVGContext, 15.0f);
-            nvgTextAlign(mNVGContext, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
-            nvgTextLineHeight(mNVGContext, 1.1f);
+            mTooltipLayout.update(mNVGContext, widget->tooltip(), "sans", 15.0f,
+                                  tooltipWidth, 1.1f);
             Vector2i pos = widget->absolutePosition() +
                            Vector2i(widget->width() / 2, widget->height() + 10);
 
-            nvgTextBoxBounds(mNVGContext, pos.x, pos.y, tooltipWidth,
-                             widget->tooltip().c_str(), nullptr, bounds);
+            mTooltipLayout.bounds(pos.x, pos.y, NVG_ALIGN_CENTER, bounds);
 
             nvgGlobalAlpha(mNVGContext,
                            std::min(1.0, 2 * (elapsed - 0.5f)) * 0.8);
@@ -307,8 +797,7 @@ void Screen::drawWidgets() {
 
             nvgFillColor(mNVGContext, Color(255, 255));
             nvgFontBlur(mNVGContext, 0.0f);
-            nvgTextBox(mNVGContext, pos.x - h, pos.y, tooltipWidth,
-                       widget->tooltip().c_str(), nullptr);
+            mTooltipLayout.draw(mNVGContext, pos.x - h, pos.y, NVG_ALIGN_CENTER);
         }
     }
 
@@ -335,7 +824,8 @@ bool Screen::keyboardCharacterEvent(unsigned int codepoint) {
 }
 
 bool Screen::cursorPosCallbackEvent(double x, double y) {
-    Vector2i p((int) x, (int) y);
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
+    Vector2i p((int) (x / mUIScale), (int) (y / mUIScale));
     bool ret = false;
     mLastInteraction = glfwGetTime();
     try {
@@ -368,6 +858,7 @@ bool Screen::cursorPosCallbackEvent(double x, double y) {
 }
 
 bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
     mModifiers = modifiers;
     mLastInteraction = glfwGetTime();
     try {
@@ -420,6 +911,7 @@ bool Screen::mouseButtonCallbackEvent(int button, int action, int modifiers) {
 }
 
 bool Screen::keyCallbackEvent(int key, int scancode, int action, int mods) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
     mLastInteraction = glfwGetTime();
     try {
         return keyboardEvent(key, scancode, action, mods);
@@ -430,6 +922,7 @@ bool Screen::keyCallbackEvent(int key, int scancode, int action, int mods) {
 }
 
 bool Screen::charCallbackEvent(unsigned int codepoint) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
     mLastInteraction = glfwGetTime();
     try {
         return keyboardCharacterEvent(codepoint);
@@ -441,6 +934,7 @@ bool Screen::charCallbackEvent(unsigned int codepoint) {
 }
 
 bool Screen::dropCallbackEvent(int count, const char **filenames) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
     std::vector<std::string> arg(count);
     for (int i = 0; i < count; ++i)
         arg[i] = filenames[i];
@@ -448,6 +942,7 @@ bool Screen::dropCallbackEvent(int count, const char **filenames) {
 }
 
 bool Screen::scrollCallbackEvent(double x, double y) {
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
     mLastInteraction = glfwGetTime();
     try {
         if (mFocusPath.size() > 1) {
@@ -469,8 +964,12 @@ bool Screen::scrollCallbackEvent(double x, double y) {
 }
 
 bool Screen::resizeCallbackEvent(int, int) {
-    glfwGetWindowSize(mGLFWWindow, &mSize[0], &mSize[1]);
-    glfwGetFramebufferSize(mGLFWWindow, &mFBSize[0], &mFBSize[1]);
+    std::lock_guard<std::recursive_mutex> guard(mUILock);
+    /* The metrics were already tracked unless GLFW is managed by the application */
+    if (mTrackMetrics)
+        updateSize();
+    else
+        queryMetrics();
     mLastInteraction = glfwGetTime();
     try {
         return resizeEvent(mSize);
@@ -481,6 +980,105 @@ bool Screen::resizeCallbackEvent(int, int) {
     }
 }
 
+bool Screen::iconifyCallbackEvent(bool iconified) {
+    mIconified = iconified;
+    if (!iconified) {
+        /* Back at full rate right away */
+        mLastInteraction = glfwGetTime();
+        glfwPostEmptyEvent();
+    }
+    return true;
+}
+
+bool Screen::focusCallbackEvent(bool focused) {
+    mWindowFocused = focused;
+    if (focused) {
+        mLastInteraction = glfwGetTime();
+        glfwPostEmptyEvent();
+    }
+    return true;
+}
+
+void Screen::setInputQueueing(bool enabled) {
+    mInputQueueing = enabled;
+    if (!enabled)
+        dispatchEvents();
+}
+
+void Screen::injectEvents(const std::vector<InputEvent> &events) {
+    for (auto const &event : events)
+        queueEvent(event);
+}
+
+void Screen::queueEvent(const InputEvent &event) {
+    if (!mInputQueueing) {
+        dispatchEvent(event);
+        return;
+    }
+
+    /* Merge with the previous event if both are of a kind that only the
+       latest state (or the sum) matters for */
+    if (!mEvents.empty() && mEvents.back().type == event.type) {
+        InputEvent &last = mEvents.back();
+        switch (event.type) {
+            case InputEvent::Type::CursorPos:
+            case InputEvent::Type::Resize:
+                last.x = event.x;
+                last.y = event.y;
+                last.time = event.time;
+                return;
+            case InputEvent::Type::Scroll:
+                last.x += event.x;
+                last.y += event.y;
+                last.time = event.time;
+                return;
+            default:
+                break;
+        }
+    }
+    mEvents.push_back(event);
+}
+
+void Screen::dispatchEvents() {
+    std::vector<InputEvent> events;
+    events.swap(mEvents);
+    for (auto const &event : events)
+        dispatchEvent(event);
+}
+
+void Screen::dispatchEvent(const InputEvent &event) {
+    switch (event.type) {
+        case InputEvent::Type::CursorPos:
+            cursorPosCallbackEvent(event.x, event.y);
+            break;
+        case InputEvent::Type::MouseButton:
+            mouseButtonCallbackEvent(event.button, event.action, event.modifiers);
+            break;
+        case InputEvent::Type::Key:
+            keyCallbackEvent(event.key, event.scancode, event.action, event.modifiers);
+            break;
+        case InputEvent::Type::Char:
+            charCallbackEvent(event.codepoint);
+            break;
+        case InputEvent::Type::Drop: {
+                std::vector<const char *> filenames;
+                for (auto const &filename : event.filenames)
+                    filenames.push_back(filename.c_str());
+                dropCallbackEvent((int) filenames.size(), filenames.data());
+            }
+            break;
+        case InputEvent::Type::Scroll:
+            scrollCallbackEvent(event.x, event.y);
+            break;
+        case InputEvent::Type::Resize:
+            resizeCallbackEvent((int) event.x, (int) event.y);
+            break;
+    }
+    /* The handlers note the dispatch time, the event knows better */
+    if (event.time > 0)
+        mLastInteraction = event.time;
+}
+
 void Screen::updateFocus(ref<Widget> widget) {
     for (auto w: mFocusPath) {
         if (!w->focused())
@@ -503,6 +1101,7 @@ void Screen::updateFocus(ref<Widget> widget) {
 }
 
 void Screen::disposeWindow(ref<Window> window) {
+    window->cancelAsync();
     if (std::find(mFocusPath.begin(), mFocusPath.end(), window) != mFocusPath.end())
         mFocusPath.clear();
     if (mDragWidget == window)
@@ -0,0 +1,309 @@
+/*
+    src/sdftext.cpp -- Signed distance field glyph atlas for text that
+    renders at any size and zoom level from a single texture
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/sdftext.h>
+#include <nanogui/primitivebatch.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/* Private copy of stb_truetype: the one compiled into NanoVG allocates
+   through fontstash's scratch buffer and cannot be used from here */
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <stb_truetype.h>
+
+NAMESPACE_BEGIN(nanogui)
+
+struct SDFText::Font {
+    stbtt_fontinfo info;
+    float baseScale;            /* Font units to pixels at the base size */
+    float ascender, descender;  /* Normalized like fontstash, multiply by the size */
+};
+
+static std::map<NVGcontext *, std::unique_ptr<SDFText>> __nanogui_sdf_text;
+
+SDFText &SDFText::get(NVGcontext *ctx) {
+    auto &text = __nanogui_sdf_text[ctx];
+    if (!text)
+        text.reset(new SDFText(ctx));
+    return *text;
+}
+
+SDFText *SDFText::find(NVGcontext *ctx) {
+    auto it = __nanogui_sdf_text.find(ctx);
+    return it == __nanogui_sdf_text.end() ? nullptr : it->second.get();
+}
+
+void SDFText::release(NVGcontext *ctx) {
+    __nanogui_sdf_text.erase(ctx);
+}
+
+SDFText::SDFText(NVGcontext *ctx) : mContext(ctx) { }
+
+SDFText::~SDFText() {
+    if (mTexture)
+        glDeleteTextures(1, &mTexture);
+}
+
+bool SDFText::addFont(const std::string &name, const uint8_t *data, size_t size) {
+    if (!data || size == 0)
+        return false;
+
+    std::unique_ptr<Font> font(new Font());
+    if (!stbtt_InitFont(&font->info, data, stbtt_GetFontOffsetForIndex(data, 0)))
+        return false;
+
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &lineGap);
+    float height = (float) (ascent - descent);
+    font->ascender = ascent / height;
+    font->descender = descent / height;
+    font->baseScale = stbtt_ScaleForPixelHeight(&font->info, (float) BaseSize);
+
+    /* Drop the glyphs of a font registered under the same name */
+    auto it = mFonts.find(name);
+    if (it != mFonts.end()) {
+        const Font *old = it->second.get();
+        for (auto g = mGlyphs.begin(); g != mGlyphs.end();)
+            g = g->first.first == old ? mGlyphs.erase(g) : std::next(g);
+    }
+    mFonts[name] = std::move(font);
+    return true;
+}
+
+static uint32_t utf8_decode_helper(const char *&str, const char *end) {
+    uint8_t c = (uint8_t) *str++;
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    uint32_t cp = extra == 0 ? c : (c & (0x3F >> extra));
+    for (int i = 0; i < extra && str < end; ++i)
+        cp = (cp << 6) | ((uint8_t) *str++ & 0x3F);
+    return cp;
+}
+
+float SDFText::layout(Font &font, float size, const char *string, const char *end,
+                      const std::function<void(int, float)> &callback) {
+    if (!end)
+        end = string + strlen(string);
+
+    float scale = font.baseScale * size / (float) BaseSize, x = 0.f;
+    int prev = -1;
+    while (string < end) {
+        int index = stbtt_FindGlyphIndex(&font.info, (int) utf8_decode_helper(string, end));
+        if (prev >= 0)
+            x += stbtt_GetGlyphKernAdvance(&font.info, prev, index) * scale;
+        if (callback)
+            callback(index, x);
+        int advance, bearing;
+        stbtt_GetGlyphHMetrics(&font.info, index, &advance, &bearing);
+        x += advance * scale;
+        prev = index;
+    }
+    return x;
+}
+
+float SDFText::textWidth(const std::string &name, float size, const char *string, const char *end) {
+    auto it = mFonts.find(name);
+    if (it == mFonts.end())
+        return 0.f;
+    return layout(*it->second, size, string, end, nullptr);
+}
+
+float SDFText::draw(PrimitiveBatch &batch, const std::string &name, float size, float x, float y,
+                    int align, const NVGcolor &color, const char *string, const char *end) {
+    auto it = mFonts.find(name);
+    if (it == mFonts.end())
+        return x;
+    Font &font = *it->second;
+
+    /* Same alignment rules as fontstash */
+    if (align & (NVG_ALIGN_CENTER | NVG_ALIGN_RIGHT)) {
+        float width = layout(font, size, string, end, nullptr);
+        x -= (align & NVG_ALIGN_CENTER) ? width * 0.5f : width;
+    }
+    if (align & NVG_ALIGN_TOP)
+        y += font.ascender * size;
+    else if (align & NVG_ALIGN_MIDDLE)
+        y += (font.ascender + font.descender) * 0.5f * size;
+    else if (align & NVG_ALIGN_BOTTOM)
+        y += font.descender * size;
+
+    float s = size / (float) BaseSize;
+    float advance = layout(font, size, string, end, [&](int index, float pen) {
+        const Glyph &g = glyph(font, index, batch);
+        if (g.w > 0)
+            batch.glyph(mContext, x + pen + g.x0 * s, y + g.y0 * s, g.w * s, g.h * s,
+                        g.uv, color, mTexture);
+    });
+    return x + advance;
+}
+
+/* Felzenszwalb & Huttenlocher: squared Euclidean distance transform of a
+   sampled function along one dimension */
+static void edt1d_helper(float *f, int n, int stride, std::vector<float> &d,
+                         std::vector<int> &v, std::vector<float> &z) {
+    const float inf = std::numeric_limits<float>::infinity();
+    d.resize(n); v.resize(n); z.resize(n + 1);
+    int k = 0;
+    v[0] = 0;
+    z[0] = -inf;
+    z[1] = inf;
+    auto intersect = [&](int q, int r) {
+        return ((f[q * stride] + q * q) - (f[r * stride] + r * r)) / (2.f * (q - r));
+    };
+    for (int q = 1; q < n; ++q) {
+        /* z[0] = -inf guarantees that k stays non-negative */
+        float s = intersect(q, v[k]);
+        while (s <= z[k])
+            s = intersect(q, v[--k]);
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = inf;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q)
+            ++k;
+        int r = v[k];
+        d[q] = (q - r) * (q - r) + f[r * stride];
+    }
+    for (int q = 0; q < n; ++q)
+        f[q * stride] = d[q];
+}
+
+static void edt2d_helper(std::vector<float> &grid, int w, int h) {
+    std::vector<float> d;
+    std::vector<int> v;
+    std::vector<float> z;
+    for (int x = 0; x < w; ++x)
+        edt1d_helper(&grid[x], h, w, d, v, z);
+    for (int y = 0; y < h; ++y)
+        edt1d_helper(&grid[(size_t) y * w], w, 1, d, v, z);
+}
+
+const SDFText::Glyph &SDFText::glyph(Font &font, int index, PrimitiveBatch &batch) {
+    auto key = std::make_pair((const Font *) &font, index);
+    auto it = mGlyphs.find(key);
+    if (it != mGlyphs.end())
+        return it->second;
+
+    Glyph g;
+    memset(&g, 0, sizeof(Glyph));
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(&font.info, index, font.baseScale, font.baseScale, &x0, &y0, &x1, &y1);
+    int gw = x1 - x0, gh = y1 - y0;
+    if (gw <= 0 || gh <= 0)
+        return mGlyphs[key] = g;
+
+    const int pad = Spread;
+    int w = gw + 2 * pad, h = gh + 2 * pad;
+    std::vector<uint8_t> bitmap((size_t) w * h, 0);
+    stbtt_MakeGlyphBitmap(&font.info, &bitmap[(size_t) pad * w + pad], gw, gh, w,
+                          font.baseScale, font.baseScale, index);
+
+    /* Distances to the outline from outside and from inside, treating
+       partially covered pixels as lying at a sub-pixel offset (as TinySDF) */
+    const float inf = 1e20f;
+    std::vector<float> outer((size_t) w * h), inner((size_t) w * h);
+    for (size_t i = 0; i < bitmap.size(); ++i) {
+        float a = bitmap[i] / 255.f;
+        if (a >= 1.f) {
+            outer[i] = 0.f; inner[i] = inf;
+        } else if (a <= 0.f) {
+            outer[i] = inf; inner[i] = 0.f;
+        } else {
+            outer[i] = std::pow(std::max(0.f, 0.5f - a), 2.f);
+            inner[i] = std::pow(std::max(0.f, a - 0.5f), 2.f);
+        }
+    }
+    edt2d_helper(outer, w, h);
+    edt2d_helper(inner, w, h);
+    for (size_t i = 0; i < bitmap.size(); ++i) {
+        float dist = std::sqrt(outer[i]) - std::sqrt(inner[i]);
+        float value = 0.5f - dist / (2.f * Spread);
+        bitmap[i] = (uint8_t) (std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+    }
+
+    int ax, ay;
+    if (!allocate(w, h, ax, ay)) {
+        /* Atlas full: start over, the glyphs in use will be added again */
+        batch.flush();
+        mGlyphs.clear();
+        mShelfX = mShelfY = mShelfHeight = 0;
+        if (!allocate(w, h, ax, ay))
+            return mGlyphs[key] = g;
+    }
+
+    GLint alignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, ax, ay, w, h, GL_RED, GL_UNSIGNED_BYTE, bitmap.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+    g.x0 = (float) (x0 - pad);
+    g.y0 = (float) (y0 - pad);
+    g.w = (float) w;
+    g.h = (float) h;
+    g.uv[0] = ax / (float) AtlasSize;
+    g.uv[1] = ay / (float) AtlasSize;
+    g.uv[2] = (ax + w) / (float) AtlasSize;
+    g.uv[3] = (ay + h) / (float) AtlasSize;
+    return mGlyphs[key] = g;
+}
+
+bool SDFText::allocate(int w, int h, int &x, int &y) {
+    if (!mTexture) {
+        glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, AtlasSize, AtlasSize, 0, GL_RED,
+                     GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    /* Shelf packing with a one pixel gap between glyphs */
+    if (mShelfX + w + 1 > AtlasSize) {
+        mShelfY += mShelfHeight + 1;
+        mShelfX = mShelfHeight = 0;
+    }
+    if (w + 1 > AtlasSize || mShelfY + h + 1 > AtlasSize)
+        return false;
+
+    x = mShelfX;
+    y = mShelfY;
+    mShelfX += w + 1;
+    mShelfHeight = std::max(mShelfHeight, h);
+    return true;
+}
+
+float nvgBatchText(NVGcontext *ctx, float x, float y, const std::string &font, float size,
+                   int align, const NVGcolor &color, const char *string, const char *end) {
+    PrimitiveBatch *batch = PrimitiveBatch::active(ctx);
+    SDFText *sdf = batch ? SDFText::find(ctx) : nullptr;
+    if (sdf && sdf->enabled() && sdf->hasFont(font))
+        return sdf->draw(*batch, font, size, x, y, align, color, string, end);
+
+    nvgFontFace(ctx, font.c_str());
+    nvgFontSize(ctx, size);
+    nvgTextAlign(ctx, align);
+    nvgFillColor(ctx, color);
+    return nvgText(ctx, x, y, string, end);
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,160 @@
+/*
+    src/shadowcache.cpp -- Precomputed 9-slice drop shadow textures
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/shadowcache.h>
+#include <nanogui/primitivebatch.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Shadow textures are rendered at twice the logical resolution so that the
+   antialiased edge along the window outline stays sharp on HiDPI screens */
+static const int __shadow_oversample = 2;
+
+/* Distinct shadows kept per context before the cache is flushed */
+static const size_t __shadow_max_images = 32;
+
+static std::map<NVGcontext *, std::unique_ptr<ShadowCache>> __nanogui_shadow_caches;
+
+ShadowCache &ShadowCache::get(NVGcontext *ctx) {
+    auto &cache = __nanogui_shadow_caches[ctx];
+    if (!cache)
+        cache.reset(new ShadowCache(ctx));
+    return *cache;
+}
+
+void ShadowCache::release(NVGcontext *ctx) {
+    __nanogui_shadow_caches.erase(ctx);
+}
+
+ShadowCache::~ShadowCache() {
+    clear();
+}
+
+void ShadowCache::clear() {
+    for (auto &kv : mImages)
+        nvgDeleteImage(mContext, kv.second);
+    mImages.clear();
+}
+
+/* Signed distance to a rounded rectangle given by its half extent, as in the NanoVG shader */
+static float sdroundrect_helper(float px, float py, float ex, float ey, float r) {
+    float dx = std::abs(px) - (ex - r), dy = std::abs(py) - (ey - r);
+    float ox = std::max(dx, 0.f), oy = std::max(dy, 0.f);
+    return std::min(std::max(dx, dy), 0.f) + std::sqrt(ox * ox + oy * oy) - r;
+}
+
+/* The shadow texture holds the shadow of a square whose sides are just long
+   enough to have a straight section between the corners. Slicing it at
+   'ds + 2 * cr' from each border separates the corners, which depend on both
+   axes, from the edges, which can be stretched along one axis. */
+int ShadowCache::image(int cr, int ds, const NVGcolor &color) {
+    auto byte = [](float v) { return (uint32_t) (std::min(std::max(v, 0.f), 1.f) * 255.f + 0.5f); };
+    uint32_t rgba = byte(color.r) | byte(color.g) << 8 | byte(color.b) << 16 | byte(color.a) << 24;
+    Key key(cr, ds, rgba);
+
+    auto it = mImages.find(key);
+    if (it != mImages.end())
+        return it->second;
+    if (mImages.size() >= __shadow_max_images)
+        clear();
+
+    const int o = __shadow_oversample;
+    int inner = 4 * cr + 2, size = inner + 2 * ds, res = size * o;
+
+    /* Same parameters as nvgBoxGradient(x, y, w, h, 2 * cr, 2 * ds, color, transparent) */
+    float center = ds + inner * 0.5f, extent = inner * 0.5f;
+    float radius = 2.f * cr, feather = std::max(1.f, 2.f * ds);
+
+    std::vector<uint8_t> pixels((size_t) res * res * 4);
+    for (int j = 0; j < res; ++j) {
+        for (int i = 0; i < res; ++i) {
+            float px = (i + 0.5f) / o - center, py = (j + 0.5f) / o - center;
+
+            float t = (sdroundrect_helper(px, py, extent, extent, radius) + feather * 0.5f) / feather;
+            t = std::min(std::max(t, 0.f), 1.f);
+
+            /* Cut out the window itself, antialiased over one texel */
+            float hole = sdroundrect_helper(px, py, extent, extent, (float) cr) * o + 0.5f;
+            hole = std::min(std::max(hole, 0.f), 1.f);
+
+            float alpha = color.a * (1.f - t) * hole;
+            uint8_t *p = &pixels[((size_t) j * res + i) * 4];
+            p[0] = (uint8_t) (color.r * alpha * 255.f + 0.5f);
+            p[1] = (uint8_t) (color.g * alpha * 255.f + 0.5f);
+            p[2] = (uint8_t) (color.b * alpha * 255.f + 0.5f);
+            p[3] = (uint8_t) (alpha * 255.f + 0.5f);
+        }
+    }
+
+    int id = nvgCreateImageRGBA(mContext, res, res, NVG_IMAGE_PREMULTIPLIED, pixels.data());
+    if (id)
+        mImages[key] = id;
+    return id;
+}
+
+bool ShadowCache::draw(float x, float y, float w, float h, int cr, int ds, const NVGcolor &color) {
+    if (ds <= 0)
+        return true;
+    if (cr < 0 || w < 4 * cr || h < 4 * cr)
+        return false;
+
+    int id = image(cr, ds, color);
+    if (!id)
+        return false;
+
+    float size = (float) (4 * cr + 2 + 2 * ds), corner = (float) (ds + 2 * cr);
+    float dstX[4] = { x - ds, x + 2 * cr, x + w - 2 * cr, x + w + ds };
+    float dstY[4] = { y - ds, y + 2 * cr, y + h - 2 * cr, y + h + ds };
+    float src[4] = { 0.f, corner, size - corner, size };
+
+    /* The slices share their edges, antialiasing would leave visible seams */
+    nvgSave(mContext);
+    nvgShapeAntiAlias(mContext, 0);
+
+    for (int j = 0; j < 3; ++j) {
+        for (int i = 0; i < 3; ++i) {
+            if (i == 1 && j == 1)
+                continue; /* Covered by the window */
+            float dw = dstX[i + 1] - dstX[i], dh = dstY[j + 1] - dstY[j];
+            if (dw <= 0 || dh <= 0)
+                continue;
+
+            float sx = dw / (src[i + 1] - src[i]), sy = dh / (src[j + 1] - src[j]);
+            NVGpaint paint = nvgImagePattern(mContext, dstX[i] - src[i] * sx, dstY[j] - src[j] * sy,
+                                             size * sx, size * sy, 0, id, 1.f);
+            nvgBeginPath(mContext);
+            nvgRect(mContext, dstX[i], dstY[j], dw, dh);
+            nvgFillPaint(mContext, paint);
+            nvgFill(mContext);
+        }
+    }
+
+    nvgRestore(mContext);
+    return true;
+}
+
+void nvgDropShadow(NVGcontext *ctx, float x, float y, float w, float h,
+                   int cr, int ds, const NVGcolor &color) {
+    /* The batch evaluates the gradient analytically in a single instance */
+    bool batched = PrimitiveBatch::active(ctx) != nullptr;
+    if (!batched && ShadowCache::get(ctx).draw(x, y, w, h, cr, ds, color))
+        return;
+
+    NVGpaint paint = nvgBoxGradient(ctx, x, y, w, h, cr * 2, ds * 2, color, nvgRGBA(0, 0, 0, 0));
+    nvgBatchFillRoundedRectHole(ctx, x - ds, y - ds, w + 2 * ds, h + 2 * ds,
+                                x, y, w, h, cr, paint);
+}
+
+NAMESPACE_END(nanogui)
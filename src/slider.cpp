@@ -12,6 +12,7 @@
 #include <nanogui/slider.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/primitivebatch.h>
 
 NAMESPACE_BEGIN(nanogui)
 
@@ -52,27 +53,20 @@ void Slider::draw(NVGcontext* ctx) {
     NVGpaint bg = nvgBoxGradient(ctx,
         mPos.x, center.y - 3 + 1, mSize.x, 6, 3, 3, Color(0, mEnabled ? 32 : 10), Color(0, mEnabled ? 128 : 210));
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x, center.y - 3 + 1, mSize.x, 6, 2);
-    nvgFillPaint(ctx, bg);
-    nvgFill(ctx);
+    nvgBatchFillRoundedRect(ctx, mPos.x, center.y - 3 + 1, mSize.x, 6, 2, bg);
 
     if (mHighlightedRange.second != mHighlightedRange.first) {
-        nvgBeginPath(ctx);
-        nvgRoundedRect(ctx, mPos.x + mHighlightedRange.first * mSize.x, center.y - 3 + 1, mSize.x * (mHighlightedRange.second-mHighlightedRange.first), 6, 2);
-        nvgFillColor(ctx, mHighlightColor);
-        nvgFill(ctx);
+        nvgBatchFillRoundedRect(ctx, mPos.x + mHighlightedRange.first * mSize.x, center.y - 3 + 1,
+                                mSize.x * (mHighlightedRange.second-mHighlightedRange.first), 6, 2,
+                                mHighlightColor);
     }
 
     NVGpaint knobShadow = nvgRadialGradient(ctx,
         knobPos.x, knobPos.y, kr-3, kr+3, Color(0, 64), mTheme->mTransparent);
 
-    nvgBeginPath(ctx);
-    nvgRect(ctx, knobPos.x - kr - 5, knobPos.y - kr - 5, kr*2+10, kr*2+10+3);
-    nvgCircle(ctx, knobPos.x, knobPos.y, kr);
-    nvgPathWinding(ctx, NVG_HOLE);
-    nvgFillPaint(ctx, knobShadow);
-    nvgFill(ctx);
+    /* Circles are rounded rectangles whose radius is half their size */
+    nvgBatchFillRoundedRectHole(ctx, knobPos.x - kr - 5, knobPos.y - kr - 5, kr*2+10, kr*2+10+3,
+                                knobPos.x - kr, knobPos.y - kr, kr*2, kr*2, kr, knobShadow);
 
     NVGpaint knob = nvgLinearGradient(ctx,
         mPos.x, center.y - kr, mPos.x, center.y + kr,
@@ -82,18 +76,13 @@ void Slider::draw(NVGcontext* ctx) {
         mTheme->mBorderMedium,
         mTheme->mBorderLight);
 
-    nvgBeginPath(ctx);
-    nvgCircle(ctx, knobPos.x, knobPos.y, kr);
-    nvgStrokeColor(ctx, mTheme->mBorderDark);
-    nvgFillPaint(ctx, knob);
-    nvgStroke(ctx);
-    nvgFill(ctx);
-    nvgBeginPath(ctx);
-    nvgCircle(ctx, knobPos.x, knobPos.y, kr/2);
-    nvgFillColor(ctx, Color(150, mEnabled ? 255 : 100));
-    nvgStrokePaint(ctx, knobReverse);
-    nvgStroke(ctx);
-    nvgFill(ctx);
+    nvgBatchStrokeRoundedRect(ctx, knobPos.x - kr, knobPos.y - kr, kr*2, kr*2, kr,
+                              mTheme->mBorderDark);
+    nvgBatchFillRoundedRect(ctx, knobPos.x - kr, knobPos.y - kr, kr*2, kr*2, kr, knob);
+    nvgBatchStrokeRoundedRect(ctx, knobPos.x - kr/2, knobPos.y - kr/2, kr, kr, kr/2,
+                              knobReverse);
+    nvgBatchFillRoundedRect(ctx, knobPos.x - kr/2, knobPos.y - kr/2, kr, kr, kr/2,
+                            Color(150, mEnabled ? 255 : 100));
 }
 
 NAMESPACE_END(nanogui)
@@ -0,0 +1,70 @@
+/*
+    src/taskqueue.cpp -- Lock-free queue for running work posted from
+    other threads on the UI thread
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/taskqueue.h>
+#include <chrono>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Intrusive MPSC queue after Dmitry Vyukov: producers swap themselves in at
+   the head, the consumer follows the 'next' links from the tail. The tail
+   node has always been consumed already and acts as a stub. */
+
+TaskQueue::TaskQueue() {
+    Node *stub = new Node();
+    stub->next.store(nullptr, std::memory_order_relaxed);
+    mHead.store(stub, std::memory_order_relaxed);
+    mTail = stub;
+}
+
+TaskQueue::~TaskQueue() {
+    Task task;
+    while (pop(task))
+        ;
+    delete mTail;
+}
+
+void TaskQueue::push(Task task) {
+    Node *node = new Node();
+    node->task = std::move(task);
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+    /* Until this store, the consumer simply sees the queue end at 'prev' */
+    prev->next.store(node, std::memory_order_release);
+}
+
+bool TaskQueue::pop(Task &task) {
+    Node *next = mTail->next.load(std::memory_order_acquire);
+    if (!next)
+        return false;
+    task = std::move(next->task);
+    next->task = nullptr;
+    delete mTail;
+    mTail = next;
+    return true;
+}
+
+size_t TaskQueue::run(double budget) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    Task task;
+    while (pop(task)) {
+        task();
+        count++;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() > budget)
+            break;
+    }
+    return count;
+}
+
+NAMESPACE_END(nanogui)
@@ -0,0 +1,49 @@
+/*
+    src/telemetry.cpp -- Lock-free sources that widgets sample once per
+    frame, and change detection to request frames for them
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/telemetry.h>
+#include <algorithm>
+#include <mutex>
+
+NAMESPACE_BEGIN(nanogui)
+
+/* Only taken by the polling thread and when widgets are (un)bound; the
+   producers of the watched values never lock */
+static std::mutex __nanogui_watch_mutex;
+static std::vector<TelemetryWatch *> __nanogui_watches;
+
+TelemetryWatch::TelemetryWatch(const std::function<bool()> &changed)
+    : mChanged(changed), mArmed(true) {
+    std::lock_guard<std::mutex> guard(__nanogui_watch_mutex);
+    __nanogui_watches.push_back(this);
+}
+
+TelemetryWatch::~TelemetryWatch() {
+    std::lock_guard<std::mutex> guard(__nanogui_watch_mutex);
+    __nanogui_watches.erase(
+        std::remove(__nanogui_watches.begin(), __nanogui_watches.end(), this),
+        __nanogui_watches.end());
+}
+
+bool TelemetryWatch::poll() {
+    std::lock_guard<std::mutex> guard(__nanogui_watch_mutex);
+    bool changed = false;
+    for (TelemetryWatch *watch : __nanogui_watches) {
+        if (watch->mArmed.load(std::memory_order_acquire) && watch->mChanged()) {
+            watch->mArmed.store(false, std::memory_order_relaxed);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+NAMESPACE_END(nanogui)
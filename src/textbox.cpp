@@ -16,6 +16,8 @@
 #include <nanogui/screen.h>
 #include <nanogui/textbox.h>
 #include <nanogui/opengl.h>
+#include <nanogui/imageatlas.h>
+#include <nanogui/primitivebatch.h>
 #include <nanogui/theme.h>
 #include <regex>
 
@@ -53,9 +55,9 @@ Vector2i TextBox::preferredSize(NVGcontext *ctx) {
     Vector2i size(0, fontSize() * 1.4f);
 
     float uw = 0;
-    if (mUnitsImage > 0) {
+    if (mUnitsImage > 0 || ImageAtlas::isAtlasImage(mUnitsImage)) {
         int w, h;
-        nvgImageSize(ctx, mUnitsImage, &w, &h);
+        nvgImageIconSize(ctx, mUnitsImage, &w, &h);
         float uh = size[1] * 0.4f;
         uw = w * uh / h;
     } else if (!mUnits.empty()) {
@@ -80,22 +82,12 @@ void TextBox::draw(NVGcontext* ctx) {
         mPos.x + 1, mPos.y + 1 + 1.0f, mSize.x - 2, mSize.y - 2,
         3, 4, nvgRGBA(255, 0, 0, 100), nvgRGBA(255, 0, 0, 50));
 
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x + 1, mPos.y + 1 + 1.0f, mSize.x - 2,
-                   mSize.y - 2, 3);
+    nvgBatchFillRoundedRect(ctx, mPos.x + 1, mPos.y + 1 + 1.0f, mSize.x - 2,
+                            mSize.y - 2, 3,
+                            mEditable && focused() ? (mValidFormat ? fg1 : fg2) : bg);
 
-    if(mEditable && focused())
-        mValidFormat ? nvgFillPaint(ctx, fg1) : nvgFillPaint(ctx, fg2);
-    else
-        nvgFillPaint(ctx, bg);
-
-    nvgFill(ctx);
-
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x + 0.5f, mPos.y + 0.5f, mSize.x - 1,
-                   mSize.y - 1, 2.5f);
-    nvgStrokeColor(ctx, Color(0, 48));
-    nvgStroke(ctx);
+    nvgBatchStrokeRoundedRect(ctx, mPos.x + 0.5f, mPos.y + 0.5f, mSize.x - 1,
+                              mSize.y - 1, 2.5f, Color(0, 48));
 
     nvgFontSize(ctx, fontSize());
     nvgFontFace(ctx, "sans");
@@ -105,15 +97,15 @@ void TextBox::draw(NVGcontext* ctx) {
 
     float unitWidth = 0;
 
-    if (mUnitsImage > 0) {
+    if (mUnitsImage > 0 || ImageAtlas::isAtlasImage(mUnitsImage)) {
         int w, h;
-        nvgImageSize(ctx, mUnitsImage, &w, &h);
+        nvgImageIconSize(ctx, mUnitsImage, &w, &h);
         float unitHeight = mSize.y * 0.4f;
         unitWidth = w * unitHeight / h;
-        NVGpaint imgPaint = nvgImagePattern(
-            ctx, mPos.x + mSize.x - xSpacing - unitWidth,
-            drawPos.y - unitHeight * 0.5f, unitWidth, unitHeight, 0,
-            mUnitsImage, mEnabled ? 0.7f : 0.35f);
+        NVGpaint imgPaint = nvgImageIconPattern(
+            ctx, mUnitsImage, mPos.x + mSize.x - xSpacing - unitWidth,
+            drawPos.y - unitHeight * 0.5f, unitWidth, unitHeight,
+            mEnabled ? 0.7f : 0.35f);
         nvgBeginPath(ctx);
         nvgRect(ctx, mPos.x + mSize.x - xSpacing - unitWidth,
                 drawPos.y - unitHeight * 0.5f, unitWidth, unitHeight);
@@ -0,0 +1,90 @@
+/*
+    src/textlayout.cpp -- Cached line breaking for wrapped paragraphs
+
+    NanoGUI was developed by Wenzel Jakob <wenzel@inf.ethz.ch>.
+    The widget drawing code is based on the NanoVG demo application
+    by Mikko Mononen.
+
+    All rights reserved. Use of this source code is governed by a
+    BSD-style license that can be found in the LICENSE.txt file.
+*/
+
+#include <nanogui/textlayout.h>
+#include <algorithm>
+
+NAMESPACE_BEGIN(nanogui)
+
+bool TextLayout::update(NVGcontext *ctx, const std::string &text, const std::string &font,
+                        float fontSize, float width, float lineHeight) {
+    nvgFontFace(ctx, font.c_str());
+    nvgFontSize(ctx, fontSize);
+    nvgTextLineHeight(ctx, lineHeight);
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+
+    if (mValid && text == mText && font == mFont && fontSize == mFontSize &&
+        width == mWidth && lineHeight == mLineHeight)
+        return false;
+
+    mText = text;
+    mFont = font;
+    mFontSize = fontSize;
+    mWidth = width;
+    mLineHeight = lineHeight;
+    mValid = true;
+    mLines.clear();
+
+    float lineh = 0, bounds[4];
+    nvgTextMetrics(ctx, nullptr, nullptr, &lineh);
+    mAdvance = lineh * lineHeight;
+
+    /* nvgTextBounds() reports the vertical extent of a whole line */
+    nvgTextBounds(ctx, 0, 0, " ", nullptr, bounds);
+    mRowMinY = bounds[1];
+    mRowMaxY = bounds[3];
+
+    const char *base = mText.c_str(), *str = base, *end = base + mText.size();
+    NVGtextRow rows[16];
+    int nrows;
+    while ((nrows = nvgTextBreakLines(ctx, str, end, width, rows, 16)) > 0) {
+        for (int i = 0; i < nrows; ++i)
+            mLines.push_back(Line { (size_t) (rows[i].start - base), (size_t) (rows[i].end - base),
+                                    rows[i].width, rows[i].minx, rows[i].maxx });
+        str = rows[nrows - 1].next;
+    }
+    return true;
+}
+
+float TextLayout::lineOffset(const Line &line, int align) const {
+    if (align & NVG_ALIGN_CENTER)
+        return mWidth * 0.5f - line.width * 0.5f;
+    else if (align & NVG_ALIGN_RIGHT)
+        return mWidth - line.width;
+    return 0.f;
+}
+
+void TextLayout::bounds(float x, float y, int align, float *bounds) const {
+    float minx = x, maxx = x, miny = y, maxy = y;
+    for (auto const &line : mLines) {
+        float dx = lineOffset(line, align);
+        minx = std::min(minx, x + line.minx + dx);
+        maxx = std::max(maxx, x + line.maxx + dx);
+        miny = std::min(miny, y + mRowMinY);
+        maxy = std::max(maxy, y + mRowMaxY);
+        y += mAdvance;
+    }
+    bounds[0] = minx;
+    bounds[1] = miny;
+    bounds[2] = maxx;
+    bounds[3] = maxy;
+}
+
+void TextLayout::draw(NVGcontext *ctx, float x, float y, int align) const {
+    nvgTextAlign(ctx, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+    const char *base = mText.c_str();
+    for (auto const &line : mLines) {
+        nvgText(ctx, x + lineOffset(line, align), y, base + line.start, base + line.end);
+        y += mAdvance;
+    }
+}
+
+NAMESPACE_END(nanogui)
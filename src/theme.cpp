@@ -12,6 +12,8 @@
 */
 
 #include <nanogui/theme.h>
+#include <nanogui/layoutpool.h>
+#include <nanogui/sdftext.h>
 #include <nanogui/opengl.h>
 #include <resources.h>
 
@@ -58,6 +60,10 @@ Theme::Theme(NVGcontext *ctx) {
     mWindowPopup                      = Color(50, 255);
     mWindowPopupTransparent           = Color(50, 0);
 
+    registerFonts(ctx);
+}
+
+void Theme::registerFonts(NVGcontext *ctx) {
 	_r::buffer robotoRegular = _r::r("assets/Roboto-Regular.ttf");
 	_r::buffer robotoBold = _r::r("assets/Roboto-Bold.ttf");
 	_r::buffer iconFont = _r::r("assets/entypo.ttf");
@@ -74,6 +80,18 @@ Theme::Theme(NVGcontext *ctx) {
 
     if (mFontNormal == -1 || mFontBold == -1 || mFontIcons == -1)
         throw std::runtime_error("Could not load fonts!");
+
+    /* Same faces for the measurement contexts used by parallel layout */
+    LayoutPool &pool = LayoutPool::get(ctx);
+    pool.addFont("sans", robotoRegular.data, robotoRegular.length);
+    pool.addFont("sans-bold", robotoBold.data, robotoBold.length);
+    pool.addFont("icons", iconFont.data, iconFont.length);
+    pool.addFont("fa", faFont.data, faFont.length);
+
+    /* Text faces for the optional distance field renderer (not used until enabled) */
+    SDFText &sdf = SDFText::get(ctx);
+    sdf.addFont("sans", robotoRegular.data, robotoRegular.length);
+    sdf.addFont("sans-bold", robotoBold.data, robotoBold.length);
 }
 
 NAMESPACE_END(nanogui)
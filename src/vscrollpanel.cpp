@@ -13,6 +13,7 @@
 #include <nanogui/vscrollpanel.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/primitivebatch.h>
 #include <iostream>
 
 NAMESPACE_BEGIN(nanogui)
@@ -109,11 +110,11 @@ void VScrollPanel::draw(NVGcontext *ctx) {
 	nvgSave(ctx);
 	nvgTranslate(ctx, mPos.x, mPos.y);
 
-	nvgSave(ctx);
-	nvgScissor(ctx, 0, 0, mSize.x - scrollThumbWidth, mSize.y);
+	nvgBatchSave(ctx);
+	nvgBatchScissor(ctx, 0, 0, mSize.x - scrollThumbWidth, mSize.y);
 	if (child->visible())
 		child->draw(ctx);
-	nvgRestore(ctx);
+	nvgBatchRestore(ctx);
 
 	// draw the scroll tab
 	float scrollXPos = mSize.x - totalScrollWidth + leftScrollMargin;
@@ -127,6 +128,7 @@ void VScrollPanel::draw(NVGcontext *ctx) {
 									4,
 									Color(0, 32),
 									Color(0, 92));
+	/* Drawn over the children, so this must not go through the batch */
 	nvgBeginPath(ctx);
 	nvgRoundedRect(ctx,
 				   scrollXPos,
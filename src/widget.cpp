@@ -42,12 +42,45 @@ void Widget::associate() {
 }
 
 Widget::~Widget() {
+    for (auto const &token : mAsyncTasks)
+        token.cancel();
 }
 
 int Widget::fontSize() const {
     return mFontSize < 0 ? mTheme->mStandardFontSize : mFontSize;
 }
 
+CancelToken Widget::runAsync(const std::function<void(const CancelToken &)> &work,
+                             const std::function<void()> &onDone) {
+    CancelToken token;
+    mAsyncTasks.push_back(token);
+    weakref<Widget> self = shared_from_this();
+
+    WorkerPool::shared().submit([work, onDone, token, self]() {
+        if (token.cancelled())
+            return;
+        work(token);
+        nanogui::post([onDone, token, self]() {
+            ref<Widget> widget = self.lock();
+            if (!widget)
+                return;
+            auto &tasks = widget->mAsyncTasks;
+            tasks.erase(std::remove(tasks.begin(), tasks.end(), token), tasks.end());
+            if (!token.cancelled() && onDone)
+                onDone();
+        });
+    });
+    return token;
+}
+
+void Widget::cancelAsync() {
+    for (auto const &token : mAsyncTasks)
+        token.cancel();
+    mAsyncTasks.clear();
+    for (auto child : mChildren)
+        child->cancelAsync();
+}
+
 Vector2i Widget::preferredSize(NVGcontext *ctx){
     if (mLayout)
         return mLayout->preferredSize(ctx, shared_from_this());
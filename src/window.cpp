@@ -12,9 +12,12 @@
 #include <nanogui/window.h>
 #include <nanogui/theme.h>
 #include <nanogui/opengl.h>
+#include <nanogui/primitivebatch.h>
+#include <nanogui/shadowcache.h>
 #include <nanogui/screen.h>
 #include <nanogui/button.h>
 #include <iostream>
+#include <cmath>
 #include <nanogui/entypo.h>
 #include <nanogui/font_awesome.h>
 
@@ -95,20 +98,11 @@ void Window::drawTitle(NVGcontext *ctx) {
 	int cr = mTheme->mWindowCornerRadius;
 	int hh = mTheme->mWindowHeaderHeight;
 
-	nvgSave(ctx);
-
-	/* Draw a drop shadow */
-	NVGpaint shadowPaint = nvgBoxGradient(
-			ctx, mPos.x, mPos.y, mSize.x, hh, cr * 2, ds * 2,
-			mTheme->mDropShadow, mTheme->mTransparent);
-
-	nvgBeginPath(ctx);
-	nvgRect(ctx, mPos.x - ds, mPos.y - ds, mSize.x + 2 * ds, hh + 2 * ds);
-	nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, hh, cr);
-	nvgPathWinding(ctx, NVG_HOLE);
-	nvgFillPaint(ctx, shadowPaint);
-	nvgFill(ctx);
+	nvgBatchSave(ctx);
 
+	/* Draw a drop shadow (the full window has already drawn its own) */
+	if (mRollable && mRolled)
+		nvgDropShadow(ctx, mPos.x, mPos.y, mSize.x, hh, cr, ds, mTheme->mDropShadow);
 
 	if (!mTitle.empty()) {
 		/* Draw header */
@@ -118,18 +112,12 @@ void Window::drawTitle(NVGcontext *ctx) {
 				mTheme->mWindowHeaderGradientTop,
 				mTheme->mWindowHeaderGradientBot);
 
-		nvgBeginPath(ctx);
-		nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, hh, cr);
+		nvgBatchFillRoundedRect(ctx, mPos.x, mPos.y, mSize.x, hh, cr, headerPaint);
 
-		nvgFillPaint(ctx, headerPaint);
-		nvgFill(ctx);
-
-		nvgBeginPath(ctx);
-		nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, hh, cr);
-		nvgStrokeColor(ctx, mTheme->mWindowHeaderSepTop);
-		nvgScissor(ctx, mPos.x, mPos.y, mSize.x, 0.5f);
-		nvgStroke(ctx);
-		nvgResetScissor(ctx);
+		nvgBatchScissor(ctx, mPos.x, mPos.y, mSize.x, 0.5f);
+		nvgBatchStrokeRoundedRect(ctx, mPos.x, mPos.y, mSize.x, hh, cr,
+		                          mTheme->mWindowHeaderSepTop);
+		nvgBatchResetScissor(ctx);
 
 		nvgBeginPath(ctx);
 		nvgMoveTo(ctx, mPos.x + 0.5f, mPos.y + hh - 1.5f);
@@ -161,7 +149,7 @@ void Window::drawTitle(NVGcontext *ctx) {
 	if (mRollable && rollButton) {
 		rollButton->draw(ctx);
 	}
-	nvgRestore(ctx);
+	nvgBatchRestore(ctx);
 }
 
 void Window::draw(NVGcontext *ctx) {
@@ -178,30 +166,42 @@ void Window::draw(NVGcontext *ctx) {
 
     /* Draw window */
     nvgSave(ctx);
-    nvgBeginPath(ctx);
-    nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr);
-
-    nvgFillColor(ctx, mMouseFocus ? mTheme->mWindowFillFocused
-                                  : mTheme->mWindowFillUnfocused);
-    nvgFill(ctx);
+    nvgBatchFillRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr,
+                            mMouseFocus ? mTheme->mWindowFillFocused
+                                        : mTheme->mWindowFillUnfocused);
 
     /* Draw a drop shadow */
-    NVGpaint shadowPaint = nvgBoxGradient(
-        ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr*2, ds*2,
-        mTheme->mDropShadow, mTheme->mTransparent);
-
-    nvgBeginPath(ctx);
-    nvgRect(ctx, mPos.x-ds,mPos.y-ds, mSize.x+2*ds, mSize.y+2*ds);
-    nvgRoundedRect(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr);
-    nvgPathWinding(ctx, NVG_HOLE);
-    nvgFillPaint(ctx, shadowPaint);
-    nvgFill(ctx);
+    nvgDropShadow(ctx, mPos.x, mPos.y, mSize.x, mSize.y, cr, ds, mTheme->mDropShadow);
 
 	drawTitle(ctx);
 
 	Widget::draw(ctx);
 }
 
+bool Window::opaqueRegion(Vector2i &pos, Vector2i &size) const {
+	if (!mVisible || (mRollable && mRolled))
+		return false;
+
+	/* Largest inset that keeps the rectangle inside the rounded corners */
+	int inset = (int) std::ceil(mTheme->mWindowCornerRadius * (1.f - std::sqrt(0.5f)));
+
+	const Color &fill = mMouseFocus ? mTheme->mWindowFillFocused
+	                                : mTheme->mWindowFillUnfocused;
+	if (fill.a >= 1.f) {
+		pos = mPos + Vector2i(inset);
+		size = mSize - Vector2i(2 * inset);
+		return size.x > 0 && size.y > 0;
+	}
+
+	/* Translucent body (as in the default theme): only the header is opaque */
+	if (mTitle.empty() || mTheme->mWindowHeaderGradientTop.a < 1.f ||
+	    mTheme->mWindowHeaderGradientBot.a < 1.f)
+		return false;
+	pos = mPos + Vector2i(inset);
+	size = Vector2i(mSize.x - 2 * inset, std::min(mTheme->mWindowHeaderHeight, mSize.y) - 2 * inset);
+	return size.x > 0 && size.y > 0;
+}
+
 void Window::addChildWindow(ref<Window> win) {
 	if (std::find(mChildWindows.begin(), mChildWindows.end(), win) != mChildWindows.end()) {
 		return; //already a child